@@ -18,6 +18,15 @@ namespace std
             return (static_cast<size_t>(key.x) << 32ull) + static_cast<size_t>(key.y);
         }
     };
+
+    template<>
+    struct hash<glm::ivec2>
+    {
+        inline size_t operator()(const glm::ivec2& key) const
+        {
+            return hash<glm::uvec2>()(glm::uvec2(key));
+        }
+    };
 }
 
 #endif
@@ -1,12 +1,17 @@
 /*
 * Template class for generating random numbers.
 * Wraps a std::19937 for generating the random numbers.
+* CellRandom instead derives the random values of every cell from a counter-based generator keyed by a seed,
+* so the value of a cell does not depend on the order in which cells are visited.
+* This makes generation reproducible from the seed and lets cells be initialized from several threads.
 */
 
 #ifndef PCG_RANDOM_H
 #define PCG_RANDOM_H
 
 #include <random>
+#include <array>
+#include <cstdint>
 
 namespace pcg
 {
@@ -33,6 +38,36 @@ namespace pcg
     template<typename T>
     using Random = BasicRandom<std::uniform_int_distribution, T>;
 
+    //The Philox4x32-10 generator of Salmon et al., "Parallel random numbers: as easy as 1, 2, 3".
+    //Returns four random values, which only depend on the counter and the key.
+    [[nodiscard]]
+    std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key);
+
+    //Random values of the cells of one level of detail. Every value is a function of the seed, the level, the position and the stream,
+    //so calls can be made in any order and from any thread.
+    class CellRandom
+    {
+    private:
+        uint64_t seed = 0u;
+        uint32_t level = 0u;
+    public:
+        CellRandom() = default;
+        CellRandom(uint64_t seed, uint32_t level);
+        //A uniformly distributed value. Different streams give independent values for the same cell.
+        [[nodiscard]]
+        uint32_t Get(uint32_t x, uint32_t y, uint32_t stream = 0u) const;
+        //A value in [min, max]. The values are very slightly biased unless max - min + 1 is a power of two.
+        [[nodiscard]]
+        uint32_t Range(uint32_t x, uint32_t y, uint32_t min, uint32_t max, uint32_t stream = 0u) const;
+        //True with a chance of percent in 100, like Random<uint32_t>(1, 100).Get() <= percent.
+        [[nodiscard]]
+        bool Percent(uint32_t x, uint32_t y, uint32_t percent, uint32_t stream = 0u) const;
+        [[nodiscard]]
+        uint64_t GetSeed() const;
+        [[nodiscard]]
+        uint32_t GetLevel() const;
+    };
+
 	template<template<typename> typename D, typename T>
 	inline BasicRandom<D, T>::BasicRandom()
 	{
@@ -82,6 +117,60 @@ namespace pcg
 	{
 		return distribution(e);
 	}
+
+    inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+    {
+        for (uint32_t round = 0u; round < 10u; round++)
+        {
+            if (round > 0u)
+            {
+                key[0] += 0x9E3779B9u;
+                key[1] += 0xBB67AE85u;
+            }
+            uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * counter[0];
+            uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * counter[2];
+            counter =
+            {
+                static_cast<uint32_t>(product1 >> 32u) ^ counter[1] ^ key[0],
+                static_cast<uint32_t>(product1),
+                static_cast<uint32_t>(product0 >> 32u) ^ counter[3] ^ key[1],
+                static_cast<uint32_t>(product0)
+            };
+        }
+        return counter;
+    }
+
+    inline CellRandom::CellRandom(uint64_t seed, uint32_t level)
+        : seed(seed), level(level) { }
+
+    inline uint32_t CellRandom::Get(uint32_t x, uint32_t y, uint32_t stream) const
+    {
+        return philox4x32(
+            { x, y, level, stream },
+            { static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32u) })[0];
+    }
+
+    inline uint32_t CellRandom::Range(uint32_t x, uint32_t y, uint32_t min, uint32_t max, uint32_t stream) const
+    {
+        //Scales the value to the range with a multiplication instead of a division:
+        uint64_t rangeSize = static_cast<uint64_t>(max) - min + 1u;
+        return min + static_cast<uint32_t>((Get(x, y, stream) * rangeSize) >> 32u);
+    }
+
+    inline bool CellRandom::Percent(uint32_t x, uint32_t y, uint32_t percent, uint32_t stream) const
+    {
+        return Range(x, y, 1u, 100u, stream) <= percent;
+    }
+
+    inline uint64_t CellRandom::GetSeed() const
+    {
+        return seed;
+    }
+
+    inline uint32_t CellRandom::GetLevel() const
+    {
+        return level;
+    }
 }
 
 #endif
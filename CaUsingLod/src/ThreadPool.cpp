@@ -0,0 +1,107 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace pcg
+{
+    //Set while a thread runs a task, so nested loops can be detected.
+    static thread_local bool insideTask = false;
+
+    ThreadPool::ThreadPool(uint32_t threadCount)
+    {
+        for (uint32_t worker = 1u; worker < threadCount; worker++)
+            threads.emplace_back(&ThreadPool::Work, this, worker);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        workReady.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    uint32_t ThreadPool::GetThreadCount() const
+    {
+        return static_cast<uint32_t>(threads.size()) + 1u;
+    }
+
+    void ThreadPool::Work(uint32_t worker)
+    {
+        uint64_t finishedGeneration = 0ull;
+        while (true)
+        {
+            {
+                std::unique_lock lock(mutex);
+                workReady.wait(lock, [&]() { return stopping || generation != finishedGeneration; });
+                if (stopping)
+                    return;
+                finishedGeneration = generation;
+            }
+            RunRanges(worker);
+            {
+                std::lock_guard lock(mutex);
+                if (--busyWorkers == 0u)
+                    workDone.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::RunRanges(uint32_t worker)
+    {
+        insideTask = true;
+        while (true)
+        {
+            uint32_t begin = nextBegin.fetch_add(rangeSize);
+            if (begin >= end)
+                break;
+            (*task)(worker, begin, std::min(begin + rangeSize, end));
+        }
+        insideTask = false;
+    }
+
+    void ThreadPool::ParallelFor(
+        uint32_t begin, uint32_t end,
+        uint32_t minRangeSize,
+        const std::function<RangeFunction>& task)
+    {
+        if (begin >= end)
+            return;
+        uint32_t count = end - begin;
+        minRangeSize = std::max(minRangeSize, 1u);
+        if (threads.empty() || insideTask || count <= minRangeSize)
+        {
+            bool wasInsideTask = insideTask;
+            insideTask = true;
+            task(0u, begin, end);
+            insideTask = wasInsideTask;
+            return;
+        }
+
+        std::lock_guard callLock(callMutex);
+        {
+            std::lock_guard lock(mutex);
+            this->task = &task;
+            this->end = end;
+            //A few ranges per thread lets threads finishing early help the others.
+            uint32_t rangeCount = GetThreadCount() * 4u;
+            rangeSize = std::max((count + rangeCount - 1u) / rangeCount, minRangeSize);
+            nextBegin = begin;
+            busyWorkers = static_cast<uint32_t>(threads.size());
+            generation++;
+        }
+        workReady.notify_all();
+        RunRanges(0u);
+
+        std::unique_lock lock(mutex);
+        workDone.wait(lock, [&]() { return busyWorkers == 0u; });
+        this->task = nullptr;
+    }
+
+    uint32_t ThreadPool::HardwareThreadCount()
+    {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+}
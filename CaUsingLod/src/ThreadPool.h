@@ -0,0 +1,63 @@
+/*
+* A pool of persistent worker threads for splitting loops over index ranges.
+* The threads are created once and sleep between calls, so a call only costs waking them up.
+* The pool is not tied to the cellular automata and can be shared by any subsystem.
+*/
+
+#ifndef PCG_THREADPOOL_H
+#define PCG_THREADPOOL_H
+
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace pcg
+{
+    class ThreadPool
+    {
+    public:
+        //Called with the index of the worker running it and a half-open range of indices.
+        //Worker indices are lower than GetThreadCount(), so they can be used for selecting per-thread scratch memory.
+        using RangeFunction = void(uint32_t worker, uint32_t begin, uint32_t end);
+    private:
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        //Only one loop runs at a time. Calls from different threads wait for each other.
+        std::mutex callMutex;
+        std::condition_variable workReady;
+        std::condition_variable workDone;
+        const std::function<RangeFunction>* task = nullptr;
+        uint32_t end = 0u;
+        uint32_t rangeSize = 1u;
+        std::atomic<uint32_t> nextBegin = 0u;
+        uint32_t busyWorkers = 0u;
+        uint64_t generation = 0ull;
+        bool stopping = false;
+
+        void Work(uint32_t worker);
+        void RunRanges(uint32_t worker);
+    public:
+        //The calling thread takes part in every loop, so threadCount - 1 threads are created.
+        explicit ThreadPool(uint32_t threadCount);
+        ThreadPool(const ThreadPool& other) = delete;
+        ThreadPool& operator=(const ThreadPool& other) = delete;
+        ~ThreadPool();
+        [[nodiscard]]
+        uint32_t GetThreadCount() const;
+        //Calls task for consecutive ranges covering [begin, end) and returns when all of them are done.
+        //Every range except the last holds at least minRangeSize indices.
+        //Calls made from inside a task of any pool run the whole range inline as worker 0, so nesting cannot deadlock.
+        void ParallelFor(
+            uint32_t begin, uint32_t end,
+            uint32_t minRangeSize,
+            const std::function<RangeFunction>& task);
+        [[nodiscard]]
+        static uint32_t HardwareThreadCount();
+    };
+}
+
+#endif
@@ -292,10 +292,9 @@ namespace pcg
                     generator.SetOptions(options0[index]);
                 };
 
-                auto optionSetter1 = [](auto& generator, uint32_t index)
+                auto optionSetter1 = [](auto& generator, uint32_t level, uint32_t index)
                 {
-                    generator.SetOptions(options1[index / options1_1.size()], 0);
-                    generator.SetOptions(options1_1[index % options1_1.size()], 1);
+                    generator.SetOptions(level == 0u ? options1[index] : options1_1[index], level);
                 };
 
                 uint32_t iterationMultiplier = 20u;
@@ -309,9 +308,10 @@ namespace pcg
                     optionSetter0,
                     false);
 
-                auto data1 = dataPoints<GeneratorType1>(
+                //Every level 0 map is shared by all the level 1 options:
+                auto data1 = lodDataPoints<GeneratorType1>(
                     *generator1.get(),
-                    options1.size() * options1_1.size(),
+                    { static_cast<uint32_t>(options1.size()), static_cast<uint32_t>(options1_1.size()) },
                     calculateX1,
                     calculateY1,
                     iterationMultiplier,
@@ -390,7 +390,7 @@ namespace pcg
 
     void CellContext::DrawGenerated(const Generator& generator)
     {
-        const auto& cells = generator.GetResult();
+        auto cells = generator.GetResult();
         auto colors = generator.GetCellColors();
         uint32_t width = generator.GetWidth();
         uint32_t height = generator.GetHeight();
@@ -401,7 +401,7 @@ namespace pcg
         for (size_t y = 0; y < height; y++)
             for (size_t x = 0; x < width; x++)
             {
-                glm::vec3 color = colors[cells[x + y * width].type];
+                glm::vec3 color = colors[cells.Get(x, y)];
                 pcg::CellShape cell
                 {
                     glm::vec2(x * cellSize, y * cellSize),
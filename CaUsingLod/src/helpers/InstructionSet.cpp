@@ -0,0 +1,95 @@
+#include "InstructionSet.h"
+
+#if PCG_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace pcg
+{
+#if PCG_X86
+    static void cpuid(uint32_t registers[4], uint32_t leaf, uint32_t subleaf)
+    {
+#ifdef _MSC_VER
+        int values[4];
+        __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; i++)
+            registers[i] = static_cast<uint32_t>(values[i]);
+#else
+        __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+    }
+
+    //Reads the register telling which vector registers the operating system saves on context switches.
+    static uint64_t xgetbv()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+
+    static InstructionSet detectInstructionSet()
+    {
+        uint32_t registers[4];
+        cpuid(registers, 0u, 0u);
+        uint32_t maxLeaf = registers[0];
+        cpuid(registers, 1u, 0u);
+        bool sse42 = (registers[2] >> 20) & 1u;
+        bool osxsave = (registers[2] >> 27) & 1u;
+        if (!sse42)
+            return InstructionSet::Scalar;
+        if (!osxsave || maxLeaf < 7u)
+            return InstructionSet::Sse42;
+
+        uint64_t savedRegisters = xgetbv();
+        bool ymmSaved = (savedRegisters & 0x6ull) == 0x6ull;
+        bool zmmSaved = (savedRegisters & 0xE6ull) == 0xE6ull;
+        cpuid(registers, 7u, 0u);
+        bool avx2 = (registers[1] >> 5) & 1u;
+        bool avx512f = (registers[1] >> 16) & 1u;
+        bool avx512bw = (registers[1] >> 30) & 1u;
+        if (avx512f && avx512bw && zmmSaved)
+            return InstructionSet::Avx512;
+        if (avx2 && ymmSaved)
+            return InstructionSet::Avx2;
+        return InstructionSet::Sse42;
+    }
+
+    static bool detectBmi2()
+    {
+        uint32_t registers[4];
+        cpuid(registers, 0u, 0u);
+        if (registers[0] < 7u)
+            return false;
+        cpuid(registers, 7u, 0u);
+        return (registers[1] >> 8) & 1u;
+    }
+#endif
+
+    InstructionSet supportedInstructionSet()
+    {
+#if PCG_X86
+        static InstructionSet instructionSet = detectInstructionSet();
+        return instructionSet;
+#else
+        return InstructionSet::Scalar;
+#endif
+    }
+
+    bool bmi2Supported()
+    {
+#if PCG_X86
+        static bool bmi2 = detectBmi2();
+        return bmi2;
+#else
+        return false;
+#endif
+    }
+}
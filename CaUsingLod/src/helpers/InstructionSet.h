@@ -0,0 +1,49 @@
+/*
+* Runtime detection of the SIMD instruction sets supported by the processor.
+* Kernels with SIMD variants are compiled for every instruction set and pick one at runtime, so one build runs on all processors.
+*/
+
+#ifndef PCG_INSTRUCTIONSET_H
+#define PCG_INSTRUCTIONSET_H
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PCG_X86 1
+#else
+#define PCG_X86 0
+#endif
+
+//Some intrinsics, like _pdep_u64, only exist on 64-bit x86, so they are left out of 32-bit builds.
+#if defined(_M_X64) || defined(__x86_64__)
+#define PCG_X64 1
+#else
+#define PCG_X64 0
+#endif
+
+//GCC and Clang only allow intrinsics of an instruction set inside functions compiled for it. MSVC allows them everywhere.
+#if PCG_X86 && (defined(__GNUC__) || defined(__clang__))
+#define PCG_TARGET(instructions) __attribute__((target(instructions)))
+#else
+#define PCG_TARGET(instructions)
+#endif
+
+namespace pcg
+{
+    enum class InstructionSet
+    {
+        Scalar,
+        Sse42,
+        Avx2,
+        Avx512
+    };
+
+    //The best instruction set supported by both the processor and the operating system.
+    [[nodiscard]]
+    InstructionSet supportedInstructionSet();
+    //True if the processor has BMI2, whose PDEP instruction scatters the bits of a word to the positions of a mask.
+    [[nodiscard]]
+    bool bmi2Supported();
+}
+
+#endif
@@ -0,0 +1,252 @@
+#include "BinaryGrid.h"
+#include <bit>
+#include <array>
+#include <algorithm>
+#if PCG_X86
+#include <immintrin.h>
+#endif
+
+namespace pcg
+{
+    void BinaryGrid::Resize(uint32_t width, uint32_t height)
+    {
+        this->width = width;
+        this->height = height;
+        wordsPerRow = (width + 63u) / 64u;
+        words.resize(static_cast<size_t>(wordsPerRow) * height);
+    }
+
+    //Returns the bits of the cells dx positions to the right. Bits outside the row are zero.
+    static uint64_t shifted(const uint64_t* row, uint32_t word, uint32_t wordsPerRow, int32_t dx)
+    {
+        if (dx > 0)
+        {
+            uint64_t next = word + 1u < wordsPerRow ? row[word + 1u] : 0ull;
+            return (row[word] >> dx) | (next << (64 - dx));
+        }
+        if (dx < 0)
+        {
+            uint64_t previous = word > 0u ? row[word - 1u] : 0ull;
+            return (row[word] << -dx) | (previous >> (64 + dx));
+        }
+        return row[word];
+    }
+
+    void BinaryGrid::Step(
+        const BinaryGrid& cells,
+        uint32_t m,
+        const BitTransition& setBits,
+        const BitTransition& clearedBits)
+    {
+        Resize(cells.width, cells.height);
+        Step(cells, m, setBits, clearedBits, 0u, height, columnCounts);
+    }
+
+    void BinaryGrid::Step(
+        const BinaryGrid& cells,
+        uint32_t m,
+        const BitTransition& setBits,
+        const BitTransition& clearedBits,
+        uint32_t rowBegin, uint32_t rowEnd,
+        std::vector<uint64_t>& columnCounts)
+    {
+        if (wordsPerRow == 0u)
+            return;
+        uint32_t side = 2u * m + 1u;
+        uint32_t columnPlanes = std::bit_width(side);
+        uint32_t totalPlanes = std::bit_width(side * side);
+        columnCounts.resize(static_cast<size_t>(columnPlanes) * wordsPerRow);
+        uint64_t lastWordMask = LastWordMask();
+        //Most rules treat both bit values the same, which saves evaluating the transitions twice.
+        bool sameTransitions = setBits == clearedBits;
+        int32_t sm = static_cast<int32_t>(m);
+
+        for (uint32_t y = rowBegin; y < rowEnd; y++)
+        {
+            //Vertical pass: count the set bits of each column within the neighbourhood rows.
+            std::fill(columnCounts.begin(), columnCounts.end(), 0ull);
+            uint32_t y0 = y > m ? y - m : 0u;
+            uint32_t y1 = std::min(y + m, height - 1u);
+            for (uint32_t y2 = y0; y2 <= y1; y2++)
+            {
+                const uint64_t* row = cells.Row(y2);
+                for (uint32_t word = 0u; word < wordsPerRow; word++)
+                {
+                    uint64_t bits = row[word];
+                    for (uint32_t p = 0u; p < columnPlanes && bits; p++)
+                    {
+                        uint64_t& plane = columnCounts[p * wordsPerRow + word];
+                        uint64_t carry = plane & bits;
+                        plane ^= bits;
+                        bits = carry;
+                    }
+                }
+            }
+
+            //Horizontal pass: add the column counts of the neighbouring columns and apply the transitions.
+            const uint64_t* row = cells.Row(y);
+            uint64_t* nextRow = Row(y);
+            for (uint32_t word = 0u; word < wordsPerRow; word++)
+            {
+                uint64_t total[maxCounterPlanes]{};
+                uint64_t column[maxCounterPlanes];
+                for (int32_t dx = -sm; dx <= sm; dx++)
+                {
+                    for (uint32_t p = 0u; p < columnPlanes; p++)
+                        column[p] = shifted(&columnCounts[p * wordsPerRow], word, wordsPerRow, dx);
+                    addCounter(total, totalPlanes, column, columnPlanes);
+                }
+                if (sameTransitions)
+                    nextRow[word] = applyTransition(total, totalPlanes, setBits);
+                else
+                    nextRow[word] =
+                        (row[word] & applyTransition(total, totalPlanes, setBits)) |
+                        (~row[word] & applyTransition(total, totalPlanes, clearedBits));
+            }
+            nextRow[wordsPerRow - 1u] &= lastWordMask;
+        }
+    }
+
+    //Spreads every bit of a byte to multiplier bits.
+    static constexpr std::array<uint32_t, 256> expansionTable(uint32_t multiplier)
+    {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t byte = 0u; byte < 256u; byte++)
+            for (uint32_t bit = 0u; bit < 8u; bit++)
+                if ((byte >> bit) & 1u)
+                    table[byte] |= ((1u << multiplier) - 1u) << (bit * multiplier);
+        return table;
+    }
+
+    static constexpr std::array<std::array<uint32_t, 256>, 3> expansionTables
+    {
+        expansionTable(2u),
+        expansionTable(3u),
+        expansionTable(4u)
+    };
+
+    //Expands a word to multiplier words, for multipliers 2 to 4, by looking up one byte at a time.
+    static void expandWordTable(uint64_t bits, uint32_t multiplier, uint64_t* expanded)
+    {
+        const std::array<uint32_t, 256>& table = expansionTables[multiplier - 2u];
+        uint32_t expandedBits = 8u * multiplier;
+        uint64_t pending = 0ull;
+        uint32_t pendingBits = 0u;
+        for (uint32_t byte = 0u; byte < 8u; byte++)
+        {
+            uint64_t value = table[(bits >> (8u * byte)) & 255u];
+            pending |= value << pendingBits;
+            pendingBits += expandedBits;
+            if (pendingBits >= 64u)
+            {
+                *expanded++ = pending;
+                pendingBits -= 64u;
+                pending = pendingBits > 0u ? value >> (expandedBits - pendingBits) : 0ull;
+            }
+        }
+    }
+
+#if PCG_X64
+    //Expands a word to multiplier words, for multipliers 2 to 4. PDEP spreads the bits to every multiplier-th position,
+    //and the multiplication fills the positions in between, as the spread bits cannot carry into each other.
+    PCG_TARGET("bmi2")
+    static void expandWordPdep(uint64_t bits, uint32_t multiplier, uint64_t* expanded)
+    {
+        switch (multiplier)
+        {
+        case 2u:
+            for (uint32_t i = 0u; i < 2u; i++)
+                expanded[i] = _pdep_u64(bits >> (32u * i), 0x5555555555555555ull) * 3ull;
+            return;
+        case 3u:
+            //Bits 21 and 42 are split between two words.
+            expanded[0] = _pdep_u64(bits, 0x9249249249249249ull) * 7ull;
+            expanded[1] = _pdep_u64(bits >> 22u, 0x4924924924924924ull) * 7ull | ((bits >> 21u) & 1ull) * 3ull;
+            expanded[2] = _pdep_u64(bits >> 43u, 0x2492492492492492ull) * 7ull | ((bits >> 42u) & 1ull);
+            return;
+        default:
+            for (uint32_t i = 0u; i < 4u; i++)
+                expanded[i] = _pdep_u64(bits >> (16u * i), 0x1111111111111111ull) * 15ull;
+            return;
+        }
+    }
+#endif
+
+    //Expands a word to multiplier words for any multiplier, one set bit at a time.
+    static void expandWordGeneric(uint64_t bits, uint32_t multiplier, uint64_t* expanded)
+    {
+        std::fill_n(expanded, multiplier, 0ull);
+        for (; bits != 0ull; bits &= bits - 1ull)
+        {
+            uint32_t begin = static_cast<uint32_t>(std::countr_zero(bits)) * multiplier;
+            uint32_t end = begin + multiplier;
+            while (begin < end)
+            {
+                uint32_t bitCount = std::min(end - begin, 64u - begin % 64u);
+                uint64_t mask = bitCount == 64u ? ~0ull : (1ull << bitCount) - 1ull;
+                expanded[begin / 64u] |= mask << (begin % 64u);
+                begin += bitCount;
+            }
+        }
+    }
+
+    void BinaryGrid::Scale(const BinaryGrid& cells, uint32_t multiplier, InstructionSet instructionSet)
+    {
+        Resize(cells.width * multiplier, cells.height * multiplier);
+        if (wordsPerRow == 0u)
+            return;
+
+        using ExpandFunction = void(uint64_t bits, uint32_t multiplier, uint64_t* expanded);
+        ExpandFunction* expandWord = expandWordGeneric;
+        if (multiplier >= 2u && multiplier <= 4u)
+            expandWord = expandWordTable;
+#if PCG_X64
+        if (multiplier >= 2u && multiplier <= 4u && instructionSet >= InstructionSet::Avx2 && bmi2Supported())
+            expandWord = expandWordPdep;
+#else
+        (void)instructionSet;
+#endif
+
+        //The expanded words of a row are written to a buffer first, since the last ones may lie beyond the scaled row.
+        std::vector<uint64_t> expandedRow(static_cast<size_t>(cells.wordsPerRow) * multiplier);
+        for (uint32_t y = 0u; y < cells.height; y++)
+        {
+            const uint64_t* row = cells.Row(y);
+            for (uint32_t word = 0u; word < cells.wordsPerRow; word++)
+                expandWord(row[word], multiplier, expandedRow.data() + static_cast<size_t>(word) * multiplier);
+            for (uint32_t i = 0u; i < multiplier; i++)
+                std::copy_n(expandedRow.data(), wordsPerRow, Row(y * multiplier + i));
+        }
+    }
+
+    uint64_t* BinaryGrid::Row(uint32_t y)
+    {
+        return words.data() + static_cast<size_t>(y) * wordsPerRow;
+    }
+
+    const uint64_t* BinaryGrid::Row(uint32_t y) const
+    {
+        return words.data() + static_cast<size_t>(y) * wordsPerRow;
+    }
+
+    uint32_t BinaryGrid::GetWidth() const
+    {
+        return width;
+    }
+
+    uint32_t BinaryGrid::GetHeight() const
+    {
+        return height;
+    }
+
+    uint32_t BinaryGrid::GetWordsPerRow() const
+    {
+        return wordsPerRow;
+    }
+
+    uint64_t BinaryGrid::LastWordMask() const
+    {
+        uint32_t usedBits = width % 64u;
+        return usedBits == 0u ? ~0ull : (1ull << usedBits) - 1ull;
+    }
+}
@@ -0,0 +1,112 @@
+/*
+* A grid storing one bit per cell, packed into 64-bit words per row.
+* Used by CellularAutomata for stepping rules with only two cell types.
+* Neighbour counts are computed with bit-sliced adders, so 64 cells are processed by every word operation.
+*/
+
+#ifndef PCG_BINARYGRID_H
+#define PCG_BINARYGRID_H
+
+#include <vector>
+#include <cstdint>
+#include "Grid.h"
+#include "BitCounters.h"
+#include "helpers/InstructionSet.h"
+
+namespace pcg
+{
+    class BinaryGrid
+    {
+    private:
+        std::vector<uint64_t> words;
+        //Bit planes of the vertical neighbour counts of one row. Reused between steps.
+        std::vector<uint64_t> columnCounts;
+        uint32_t width = 0u;
+        uint32_t height = 0u;
+        uint32_t wordsPerRow = 0u;
+    public:
+        static constexpr uint32_t maxRadius = 63u;
+
+        void Resize(uint32_t width, uint32_t height);
+        //Sets the bit of every cell of oneType. Returns false if a cell is neither oneType nor zeroType.
+        template<typename T>
+        [[nodiscard]]
+        bool Pack(BasicGridView<T> cells, uint32_t oneType, uint32_t zeroType);
+        template<typename T>
+        void Unpack(BasicGrid<T>& cells, uint32_t oneType, uint32_t zeroType) const;
+        //Writes the next generation of cells into this grid.
+        //The counts are the numbers of set bits within the Moore neighbourhood of radius m.
+        void Step(
+            const BinaryGrid& cells,
+            uint32_t m,
+            const BitTransition& setBits,
+            const BitTransition& clearedBits);
+        //Writes the rows [rowBegin, rowEnd) of the next generation. This grid must already have the size of cells.
+        //Bands of rows can be stepped concurrently as long as each has its own columnCounts.
+        void Step(
+            const BinaryGrid& cells,
+            uint32_t m,
+            const BitTransition& setBits,
+            const BitTransition& clearedBits,
+            uint32_t rowBegin, uint32_t rowEnd,
+            std::vector<uint64_t>& columnCounts);
+        //Writes cells scaled by the multiplier into this grid. Every bit becomes a block of multiplier * multiplier bits.
+        //Whole words are expanded at once for multipliers 2, 3 and 4, using PDEP on 64-bit x86 if the instruction set
+        //allows AVX2 and the processor has BMI2, and byte tables otherwise.
+        void Scale(const BinaryGrid& cells, uint32_t multiplier, InstructionSet instructionSet);
+        [[nodiscard]]
+        uint64_t* Row(uint32_t y);
+        [[nodiscard]]
+        const uint64_t* Row(uint32_t y) const;
+        [[nodiscard]]
+        uint32_t GetWidth() const;
+        [[nodiscard]]
+        uint32_t GetHeight() const;
+        [[nodiscard]]
+        uint32_t GetWordsPerRow() const;
+        //Mask of the bits in the last word of a row which belong to cells.
+        [[nodiscard]]
+        uint64_t LastWordMask() const;
+    };
+
+    template<typename T>
+    inline bool BinaryGrid::Pack(BasicGridView<T> cells, uint32_t oneType, uint32_t zeroType)
+    {
+        Resize(cells.GetWidth(), cells.GetHeight());
+        for (uint32_t y = 0u; y < height; y++)
+        {
+            const T* row = cells.Row(y);
+            uint64_t* packedRow = Row(y);
+            for (uint32_t word = 0u; word < wordsPerRow; word++)
+            {
+                uint32_t x0 = word * 64u;
+                uint32_t x1 = std::min(x0 + 64u, width);
+                uint64_t bits = 0ull;
+                for (uint32_t x = x0; x < x1; x++)
+                {
+                    uint32_t type = row[x];
+                    if (type != oneType && type != zeroType)
+                        return false;
+                    bits |= static_cast<uint64_t>(type == oneType) << (x - x0);
+                }
+                packedRow[word] = bits;
+            }
+        }
+        return true;
+    }
+
+    template<typename T>
+    inline void BinaryGrid::Unpack(BasicGrid<T>& cells, uint32_t oneType, uint32_t zeroType) const
+    {
+        cells.Resize(width, height);
+        for (uint32_t y = 0u; y < height; y++)
+        {
+            T* row = cells.Row(y);
+            const uint64_t* packedRow = Row(y);
+            for (uint32_t x = 0u; x < width; x++)
+                row[x] = static_cast<T>((packedRow[x / 64u] >> (x % 64u)) & 1ull ? oneType : zeroType);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+* Counters stored as bit planes, where bit i of plane p is bit p of counter i.
+* Every operation works on 64 counters at once using only bitwise logic.
+* Used by BinaryGrid, where the counters belong to neighbouring cells, and by SlicedGrid, where they belong to separate grids.
+*/
+
+#ifndef PCG_BITCOUNTERS_H
+#define PCG_BITCOUNTERS_H
+
+#include <cstdint>
+
+namespace pcg
+{
+    //Next bit of the cells with one bit value. Counts in [minCount, maxCount] give bitInside, other counts give bitOutside.
+    struct BitTransition
+    {
+        uint32_t minCount = 0u;
+        uint32_t maxCount = 0u;
+        bool bitInside = false;
+        bool bitOutside = false;
+
+        bool operator==(const BitTransition& other) const = default;
+    };
+
+    //Enough planes for the neighbourhood counts of any radius up to 127.
+    inline constexpr uint32_t maxCounterPlanes = 16u;
+
+    //Adds the set bits to the counters.
+    inline void addBits(uint64_t* counter, uint32_t planes, uint64_t bits)
+    {
+        for (uint32_t p = 0u; p < planes && bits; p++)
+        {
+            uint64_t carry = counter[p] & bits;
+            counter[p] ^= bits;
+            bits = carry;
+        }
+    }
+
+    //Adds two counters stored as bit planes using a ripple-carry adder. Every bit position is a separate counter.
+    inline void addCounter(
+        uint64_t* total, uint32_t totalPlanes,
+        const uint64_t* counter, uint32_t planes)
+    {
+        uint64_t carry = 0ull;
+        for (uint32_t p = 0u; p < totalPlanes; p++)
+        {
+            uint64_t bits = p < planes ? counter[p] : 0ull;
+            uint64_t sum = total[p] ^ bits ^ carry;
+            carry = (total[p] & bits) | (carry & (total[p] ^ bits));
+            total[p] = sum;
+        }
+    }
+
+    //Sets the bits of the counters which are at least t.
+    inline uint64_t atLeast(const uint64_t* counter, uint32_t planes, uint32_t t)
+    {
+        if (t >> planes)
+            return 0ull;
+        uint64_t greater = 0ull;
+        uint64_t equal = ~0ull;
+        for (int32_t p = static_cast<int32_t>(planes) - 1; p >= 0; p--)
+        {
+            if ((t >> p) & 1u)
+                equal &= counter[p];
+            else
+            {
+                greater |= equal & counter[p];
+                equal &= ~counter[p];
+            }
+        }
+        return greater | equal;
+    }
+
+    //Returns the next bits of the cells following the transition, given the counters of their neighbourhoods.
+    inline uint64_t applyTransition(const uint64_t* counter, uint32_t planes, const BitTransition& transition)
+    {
+        uint64_t inside = atLeast(counter, planes, transition.minCount);
+        if (transition.maxCount < (1u << planes) - 1u)
+            inside &= ~atLeast(counter, planes, transition.maxCount + 1u);
+        uint64_t bitInside = transition.bitInside ? ~0ull : 0ull;
+        uint64_t bitOutside = transition.bitOutside ? ~0ull : 0ull;
+        return (inside & bitInside) | (~inside & bitOutside);
+    }
+}
+
+#endif
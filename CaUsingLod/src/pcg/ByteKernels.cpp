@@ -0,0 +1,406 @@
+#include "ByteKernels.h"
+#include <algorithm>
+#if PCG_X86
+#include <immintrin.h>
+#endif
+
+namespace pcg
+{
+    using AddRowFunction = void(
+        const uint8_t* row, uint8_t* columns, uint32_t width, uint8_t countedType, bool subtract);
+    using RuleRowFunction = void(
+        const uint8_t* columns, const uint8_t* row, uint8_t* nextRow,
+        uint32_t width, const ByteRule& rule);
+
+    std::optional<ByteRule> ByteRule::FromTable(const RuleTable& table, uint32_t m, uint32_t countedType)
+    {
+        if (m > maxByteKernelRadius || countedType > 255u || table.MaxNextType() > 255u)
+            return std::nullopt;
+        if (table.GetTypeCount() > maxTransitions)
+            return std::nullopt;
+
+        auto toTransition = [](uint32_t cellType, const RuleTable::Interval& interval)
+        {
+            return ByteTransition
+            {
+                static_cast<uint8_t>(cellType),
+                static_cast<uint8_t>(std::min(interval.minCount, 255u)),
+                static_cast<uint8_t>(std::min(interval.maxCount, 255u)),
+                static_cast<uint8_t>(interval.typeInside),
+                static_cast<uint8_t>(interval.typeOutside)
+            };
+        };
+
+        ByteRule rule;
+        rule.m = m;
+        rule.countedType = static_cast<uint8_t>(countedType);
+        for (uint32_t cellType = 0u; cellType < table.GetTypeCount(); cellType++)
+        {
+            auto interval = table.RowInterval(cellType);
+            if (!interval)
+                return std::nullopt;
+            rule.transitions[rule.transitionCount++] = toTransition(cellType, *interval);
+        }
+
+        //The row of the other types can only keep the type if it does so for every count:
+        uint32_t otherTypes = table.GetTypeCount();
+        const uint32_t* row = table.Row(otherTypes);
+        rule.keepOtherTypes = table.HigherTypesKept();
+        if (!rule.keepOtherTypes)
+        {
+            if (std::find(row, row + table.GetMaxCount() + 1u, RuleTable::keepType) != row + table.GetMaxCount() + 1u)
+                return std::nullopt;
+            auto interval = table.RowInterval(otherTypes);
+            if (!interval)
+                return std::nullopt;
+            rule.otherTypes = toTransition(otherTypes, *interval);
+        }
+        return rule;
+    }
+
+    static uint8_t applyTransition(const ByteTransition& transition, uint8_t sum)
+    {
+        bool inside = sum >= transition.minCount && sum <= transition.maxCount;
+        return inside ? transition.typeInside : transition.typeOutside;
+    }
+
+    static void addRowScalar(
+        const uint8_t* row, uint8_t* columns, uint32_t begin, uint32_t width,
+        uint8_t countedType, bool subtract)
+    {
+        for (uint32_t x = begin; x < width; x++)
+        {
+            uint8_t match = row[x] == countedType;
+            columns[x] = subtract ? columns[x] - match : columns[x] + match;
+        }
+    }
+
+    static void ruleRowScalar(
+        const uint8_t* columns, const uint8_t* row, uint8_t* nextRow,
+        uint32_t begin, uint32_t width, const ByteRule& rule)
+    {
+        for (uint32_t x = begin; x < width; x++)
+        {
+            uint8_t sum = 0u;
+            for (uint32_t d = 0u; d <= 2u * rule.m; d++)
+                sum += columns[x + d];
+            uint8_t cell = row[x];
+            uint8_t next = rule.keepOtherTypes ? cell : applyTransition(rule.otherTypes, sum);
+            for (uint32_t i = 0u; i < rule.transitionCount; i++)
+                if (cell == rule.transitions[i].cellType)
+                    next = applyTransition(rule.transitions[i], sum);
+            nextRow[x] = next;
+        }
+    }
+
+    static void addRowScalar(
+        const uint8_t* row, uint8_t* columns, uint32_t width, uint8_t countedType, bool subtract)
+    {
+        addRowScalar(row, columns, 0u, width, countedType, subtract);
+    }
+
+    static void ruleRowScalar(
+        const uint8_t* columns, const uint8_t* row, uint8_t* nextRow,
+        uint32_t width, const ByteRule& rule)
+    {
+        ruleRowScalar(columns, row, nextRow, 0u, width, rule);
+    }
+
+#if PCG_X86
+    //Comparing with the counted type gives -1 for matches, so matches are added by subtracting the comparison.
+    PCG_TARGET("sse4.2")
+    static void addRowSse42(
+        const uint8_t* row, uint8_t* columns, uint32_t width, uint8_t countedType, bool subtract)
+    {
+        __m128i counted = _mm_set1_epi8(static_cast<char>(countedType));
+        uint32_t x = 0u;
+        for (; x + 16u <= width; x += 16u)
+        {
+            __m128i cells = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i match = _mm_cmpeq_epi8(cells, counted);
+            __m128i counts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + x));
+            counts = subtract ? _mm_add_epi8(counts, match) : _mm_sub_epi8(counts, match);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(columns + x), counts);
+        }
+        addRowScalar(row, columns, x, width, countedType, subtract);
+    }
+
+    struct TransitionSse42
+    {
+        __m128i cellType;
+        __m128i minCount;
+        __m128i maxCount;
+        __m128i typeInside;
+        __m128i typeOutside;
+    };
+
+    PCG_TARGET("sse4.2")
+    static TransitionSse42 broadcastSse42(const ByteTransition& transition)
+    {
+        return
+        {
+            _mm_set1_epi8(static_cast<char>(transition.cellType)),
+            _mm_set1_epi8(static_cast<char>(transition.minCount)),
+            _mm_set1_epi8(static_cast<char>(transition.maxCount)),
+            _mm_set1_epi8(static_cast<char>(transition.typeInside)),
+            _mm_set1_epi8(static_cast<char>(transition.typeOutside))
+        };
+    }
+
+    PCG_TARGET("sse4.2")
+    static __m128i applySse42(const TransitionSse42& transition, __m128i sum)
+    {
+        __m128i aboveMin = _mm_cmpeq_epi8(_mm_max_epu8(sum, transition.minCount), sum);
+        __m128i belowMax = _mm_cmpeq_epi8(_mm_min_epu8(sum, transition.maxCount), sum);
+        __m128i inside = _mm_and_si128(aboveMin, belowMax);
+        return _mm_blendv_epi8(transition.typeOutside, transition.typeInside, inside);
+    }
+
+    PCG_TARGET("sse4.2")
+    static void ruleRowSse42(
+        const uint8_t* columns, const uint8_t* row, uint8_t* nextRow,
+        uint32_t width, const ByteRule& rule)
+    {
+        TransitionSse42 transitions[ByteRule::maxTransitions];
+        for (uint32_t i = 0u; i < rule.transitionCount; i++)
+            transitions[i] = broadcastSse42(rule.transitions[i]);
+        TransitionSse42 otherTypes = broadcastSse42(rule.otherTypes);
+
+        uint32_t x = 0u;
+        for (; x + 16u <= width; x += 16u)
+        {
+            __m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + x));
+            for (uint32_t d = 1u; d <= 2u * rule.m; d++)
+                sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + x + d)));
+            __m128i cells = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i next = rule.keepOtherTypes ? cells : applySse42(otherTypes, sum);
+            for (uint32_t i = 0u; i < rule.transitionCount; i++)
+            {
+                __m128i match = _mm_cmpeq_epi8(cells, transitions[i].cellType);
+                next = _mm_blendv_epi8(next, applySse42(transitions[i], sum), match);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(nextRow + x), next);
+        }
+        ruleRowScalar(columns, row, nextRow, x, width, rule);
+    }
+
+    PCG_TARGET("avx2")
+    static void addRowAvx2(
+        const uint8_t* row, uint8_t* columns, uint32_t width, uint8_t countedType, bool subtract)
+    {
+        __m256i counted = _mm256_set1_epi8(static_cast<char>(countedType));
+        uint32_t x = 0u;
+        for (; x + 32u <= width; x += 32u)
+        {
+            __m256i cells = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+            __m256i match = _mm256_cmpeq_epi8(cells, counted);
+            __m256i counts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + x));
+            counts = subtract ? _mm256_add_epi8(counts, match) : _mm256_sub_epi8(counts, match);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(columns + x), counts);
+        }
+        addRowScalar(row, columns, x, width, countedType, subtract);
+    }
+
+    struct TransitionAvx2
+    {
+        __m256i cellType;
+        __m256i minCount;
+        __m256i maxCount;
+        __m256i typeInside;
+        __m256i typeOutside;
+    };
+
+    PCG_TARGET("avx2")
+    static TransitionAvx2 broadcastAvx2(const ByteTransition& transition)
+    {
+        return
+        {
+            _mm256_set1_epi8(static_cast<char>(transition.cellType)),
+            _mm256_set1_epi8(static_cast<char>(transition.minCount)),
+            _mm256_set1_epi8(static_cast<char>(transition.maxCount)),
+            _mm256_set1_epi8(static_cast<char>(transition.typeInside)),
+            _mm256_set1_epi8(static_cast<char>(transition.typeOutside))
+        };
+    }
+
+    PCG_TARGET("avx2")
+    static __m256i applyAvx2(const TransitionAvx2& transition, __m256i sum)
+    {
+        __m256i aboveMin = _mm256_cmpeq_epi8(_mm256_max_epu8(sum, transition.minCount), sum);
+        __m256i belowMax = _mm256_cmpeq_epi8(_mm256_min_epu8(sum, transition.maxCount), sum);
+        __m256i inside = _mm256_and_si256(aboveMin, belowMax);
+        return _mm256_blendv_epi8(transition.typeOutside, transition.typeInside, inside);
+    }
+
+    PCG_TARGET("avx2")
+    static void ruleRowAvx2(
+        const uint8_t* columns, const uint8_t* row, uint8_t* nextRow,
+        uint32_t width, const ByteRule& rule)
+    {
+        TransitionAvx2 transitions[ByteRule::maxTransitions];
+        for (uint32_t i = 0u; i < rule.transitionCount; i++)
+            transitions[i] = broadcastAvx2(rule.transitions[i]);
+        TransitionAvx2 otherTypes = broadcastAvx2(rule.otherTypes);
+
+        uint32_t x = 0u;
+        for (; x + 32u <= width; x += 32u)
+        {
+            __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + x));
+            for (uint32_t d = 1u; d <= 2u * rule.m; d++)
+                sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + x + d)));
+            __m256i cells = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+            __m256i next = rule.keepOtherTypes ? cells : applyAvx2(otherTypes, sum);
+            for (uint32_t i = 0u; i < rule.transitionCount; i++)
+            {
+                __m256i match = _mm256_cmpeq_epi8(cells, transitions[i].cellType);
+                next = _mm256_blendv_epi8(next, applyAvx2(transitions[i], sum), match);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(nextRow + x), next);
+        }
+        ruleRowScalar(columns, row, nextRow, x, width, rule);
+    }
+
+    PCG_TARGET("avx512f,avx512bw")
+    static void addRowAvx512(
+        const uint8_t* row, uint8_t* columns, uint32_t width, uint8_t countedType, bool subtract)
+    {
+        __m512i counted = _mm512_set1_epi8(static_cast<char>(countedType));
+        __m512i ones = _mm512_set1_epi8(1);
+        uint32_t x = 0u;
+        for (; x + 64u <= width; x += 64u)
+        {
+            __m512i cells = _mm512_loadu_si512(row + x);
+            __mmask64 match = _mm512_cmpeq_epi8_mask(cells, counted);
+            __m512i counts = _mm512_loadu_si512(columns + x);
+            counts = subtract ?
+                _mm512_mask_sub_epi8(counts, match, counts, ones) :
+                _mm512_mask_add_epi8(counts, match, counts, ones);
+            _mm512_storeu_si512(columns + x, counts);
+        }
+        addRowScalar(row, columns, x, width, countedType, subtract);
+    }
+
+    struct TransitionAvx512
+    {
+        __m512i cellType;
+        __m512i minCount;
+        __m512i maxCount;
+        __m512i typeInside;
+        __m512i typeOutside;
+    };
+
+    PCG_TARGET("avx512f,avx512bw")
+    static TransitionAvx512 broadcastAvx512(const ByteTransition& transition)
+    {
+        return
+        {
+            _mm512_set1_epi8(static_cast<char>(transition.cellType)),
+            _mm512_set1_epi8(static_cast<char>(transition.minCount)),
+            _mm512_set1_epi8(static_cast<char>(transition.maxCount)),
+            _mm512_set1_epi8(static_cast<char>(transition.typeInside)),
+            _mm512_set1_epi8(static_cast<char>(transition.typeOutside))
+        };
+    }
+
+    PCG_TARGET("avx512f,avx512bw")
+    static __m512i applyAvx512(const TransitionAvx512& transition, __m512i sum)
+    {
+        __mmask64 inside =
+            _mm512_cmpge_epu8_mask(sum, transition.minCount) &
+            _mm512_cmple_epu8_mask(sum, transition.maxCount);
+        return _mm512_mask_blend_epi8(inside, transition.typeOutside, transition.typeInside);
+    }
+
+    PCG_TARGET("avx512f,avx512bw")
+    static void ruleRowAvx512(
+        const uint8_t* columns, const uint8_t* row, uint8_t* nextRow,
+        uint32_t width, const ByteRule& rule)
+    {
+        TransitionAvx512 transitions[ByteRule::maxTransitions];
+        for (uint32_t i = 0u; i < rule.transitionCount; i++)
+            transitions[i] = broadcastAvx512(rule.transitions[i]);
+        TransitionAvx512 otherTypes = broadcastAvx512(rule.otherTypes);
+
+        uint32_t x = 0u;
+        for (; x + 64u <= width; x += 64u)
+        {
+            __m512i sum = _mm512_loadu_si512(columns + x);
+            for (uint32_t d = 1u; d <= 2u * rule.m; d++)
+                sum = _mm512_add_epi8(sum, _mm512_loadu_si512(columns + x + d));
+            __m512i cells = _mm512_loadu_si512(row + x);
+            __m512i next = rule.keepOtherTypes ? cells : applyAvx512(otherTypes, sum);
+            for (uint32_t i = 0u; i < rule.transitionCount; i++)
+            {
+                __mmask64 match = _mm512_cmpeq_epi8_mask(cells, transitions[i].cellType);
+                next = _mm512_mask_blend_epi8(match, next, applyAvx512(transitions[i], sum));
+            }
+            _mm512_storeu_si512(nextRow + x, next);
+        }
+        ruleRowScalar(columns, row, nextRow, x, width, rule);
+    }
+#endif
+
+    void stepByteRule(
+        BasicGridView<uint8_t> cells,
+        BasicGrid<uint8_t>& nextCells,
+        const ByteRule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        std::vector<uint8_t>& columnCounts,
+        InstructionSet instructionSet,
+        uint32_t columnBegin, uint32_t columnEnd)
+    {
+        uint32_t height = cells.GetHeight();
+        uint32_t m = rule.m;
+        rowEnd = std::min(rowEnd, height);
+        columnEnd = std::min(columnEnd, cells.GetWidth());
+        if (columnBegin >= columnEnd || rowBegin >= rowEnd)
+            return;
+        uint32_t width = columnEnd - columnBegin;
+
+        AddRowFunction* addRow = addRowScalar;
+        RuleRowFunction* ruleRow = ruleRowScalar;
+#if PCG_X86
+        switch (instructionSet)
+        {
+        case InstructionSet::Avx512:
+            addRow = addRowAvx512;
+            ruleRow = ruleRowAvx512;
+            break;
+        case InstructionSet::Avx2:
+            addRow = addRowAvx2;
+            ruleRow = ruleRowAvx2;
+            break;
+        case InstructionSet::Sse42:
+            addRow = addRowSse42;
+            ruleRow = ruleRowSse42;
+            break;
+        default:
+            break;
+        }
+#endif
+
+        //The column counts cover m more columns on both sides of the range, which come from the halo at the edges of the grid.
+        //The rule row then reads them without checking the edges.
+        uint32_t paddedWidth = width + 2u * m;
+        columnCounts.assign(paddedWidth, 0u);
+        int32_t sm = static_cast<int32_t>(m);
+        int32_t begin = static_cast<int32_t>(rowBegin);
+        auto addRowWithHalo = [&](int32_t y, bool subtract)
+        {
+            addRow(cells.Row(y) + columnBegin - m, columnCounts.data(), paddedWidth, rule.countedType, subtract);
+        };
+
+        for (int32_t y = begin - sm; y <= begin + sm; y++)
+            addRowWithHalo(y, false);
+        for (int32_t y = begin; y < static_cast<int32_t>(rowEnd); y++)
+        {
+            //Slide the vertical window one row down:
+            if (y > begin)
+            {
+                addRowWithHalo(y + sm, false);
+                addRowWithHalo(y - sm - 1, true);
+            }
+            ruleRow(columnCounts.data(), cells.Row(y) + columnBegin, nextCells.Row(y) + columnBegin, width, rule);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/*
+* Stepping kernels for grids storing one byte per cell.
+* The kernels keep a running count of the matching cells of every column while moving down the grid.
+* Every row is then finished with a horizontal sum over the column counts, which is turned into the next types using the intervals of a ByteRule.
+* SSE4.2, AVX2 and AVX-512 variants are picked at runtime. The scalar variant gives identical results.
+*/
+
+#ifndef PCG_BYTEKERNELS_H
+#define PCG_BYTEKERNELS_H
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include "Grid.h"
+#include "Rules.h"
+#include "helpers/InstructionSet.h"
+
+namespace pcg
+{
+    //Neighbour counts are kept in bytes, so the whole neighbourhood must have at most 255 cells.
+    inline constexpr uint32_t maxByteKernelRadius = 7u;
+
+    //Cells with a count in [minCount, maxCount] become typeInside, other cells become typeOutside.
+    struct ByteTransition
+    {
+        uint8_t cellType = 0u;
+        uint8_t minCount = 0u;
+        uint8_t maxCount = 0u;
+        uint8_t typeInside = 0u;
+        uint8_t typeOutside = 0u;
+    };
+
+    //A Moore neighbourhood rule in the form run by the byte kernels.
+    //Cells of the types of the transitions use these. Other cells use otherTypes, or keep their type if keepOtherTypes is set.
+    struct ByteRule
+    {
+        static constexpr uint32_t maxTransitions = 4u;
+
+        uint32_t m = 1u;
+        uint8_t countedType = 1u;
+        ByteTransition transitions[maxTransitions];
+        uint32_t transitionCount = 0u;
+        ByteTransition otherTypes;
+        bool keepOtherTypes = false;
+
+        //Returns nothing if the table has too many rows, has rows which are not intervals or produces types above 255.
+        [[nodiscard]]
+        static std::optional<ByteRule> FromTable(const RuleTable& table, uint32_t m, uint32_t countedType);
+    };
+
+    //Writes the rows [rowBegin, rowEnd) of the next generation of cells into nextCells, which must have the size of cells.
+    //Neighbours outside the grid are read from the halo of cells, which must be at least m cells wide.
+    //columnCounts is scratch memory which keeps its capacity between calls.
+    //Bands of rows can be stepped concurrently as long as each has its own columnCounts.
+    //Only the columns [columnBegin, columnEnd) of the rows are written.
+    void stepByteRule(
+        BasicGridView<uint8_t> cells,
+        BasicGrid<uint8_t>& nextCells,
+        const ByteRule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        std::vector<uint8_t>& columnCounts,
+        InstructionSet instructionSet,
+        uint32_t columnBegin = 0u, uint32_t columnEnd = std::numeric_limits<uint32_t>::max());
+}
+
+#endif
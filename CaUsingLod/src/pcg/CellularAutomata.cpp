@@ -4,34 +4,73 @@
 #include <iostream>
 #include <stack>
 #include <map>
+#include <bit>
 #include "Heuristic.h"
+#include "RandomKernels.h"
 
 namespace pcg
 {
     CellularAutomata::CellularAutomata(uint32_t width, uint32_t height)
-        : width(width), height(height), initWidth(width), initHeight(height)
+        : width(width), height(height), initWidth(width), initHeight(height),
+        cells(width, height, Boundary{}.haloSize), nextCells(width, height, Boundary{}.haloSize)
     {
-        cells.resize(width * height);
+        cells.UpdateHalo(boundary);
     }
 
-    uint32_t getIndex(uint32_t x, uint32_t y, uint32_t width)
+    void CellularAutomata::SetInitializer(std::function<InitFunction> initializer)
     {
-        return x + y * width;
+        this->initializer = initializer;
     }
 
-    uint32_t CellularAutomata::GetIndex(uint32_t x, uint32_t y) const
+    void CellularAutomata::SetRule(std::function<RuleFunction> rule)
     {
-        return getIndex(x, y, width);
+        this->rule = rule;
+        declarativeRule.reset();
+        byteRule.reset();
+        histogramRule.reset();
+        trackedSteps = 0u;
+        quadtreeReset = false;
     }
 
-    void CellularAutomata::SetInitializer(std::function<InitFunction> initializer)
+    void CellularAutomata::SetRule(const ThresholdRule& rule)
     {
-        this->initializer = initializer;
+        SetRule(OuterTotalisticRule::Threshold(rule));
     }
 
-    void CellularAutomata::SetRule(std::function<RuleFunction> rule)
+    void CellularAutomata::SetRule(const OuterTotalisticRule& rule)
     {
-        this->rule = rule;
+        ruleTable = rule.Compile();
+        this->rule = [rule, table = ruleTable](const CellularAutomata& ca, uint32_t x, uint32_t y)
+        {
+            uint32_t count = rule.neighbourhood == Neighbourhood::Moore ?
+                ca.MooreCount(x, y, rule.m, rule.countedType) :
+                ca.VonNeumannCount(x, y, rule.m, rule.countedType);
+            return table.Get(ca.GetCell(x, y).type, count);
+        };
+        declarativeRule = rule;
+        byteRule.reset();
+        histogramRule.reset();
+        trackedSteps = 0u;
+        quadtreeReset = false;
+        if (rule.neighbourhood == Neighbourhood::Moore)
+            byteRule = ByteRule::FromTable(ruleTable, rule.m, rule.countedType);
+    }
+
+    void CellularAutomata::SetRule(const HistogramRule& rule)
+    {
+        //Counting every type cell by cell gives the same counts, for the function engine and radii beyond the halo:
+        this->rule = [rule](const CellularAutomata& ca, uint32_t x, uint32_t y)
+        {
+            HistogramRule::Counts counts{};
+            for (uint32_t t = 0u; t < std::min(rule.typeCount, HistogramRule::maxTypeCount); t++)
+                counts[t] = static_cast<uint16_t>(ca.MooreCount(x, y, rule.m, t));
+            return rule.next(ca.GetCell(x, y).type, counts.data(), x, y);
+        };
+        declarativeRule.reset();
+        byteRule.reset();
+        histogramRule = rule;
+        trackedSteps = 0u;
+        quadtreeReset = false;
     }
 
     void CellularAutomata::SetCostFunction(std::function<CostFunction> costFunction)
@@ -39,14 +78,82 @@ namespace pcg
         this->costFunction = costFunction;
     }
 
+    void CellularAutomata::SetCountingMode(CountingMode countingMode, TypeMask countedTypes)
+    {
+        this->countingMode = countingMode;
+        this->countedTypes = countedTypes;
+        if (countingMode == CountingMode::SummedAreaTable)
+            tables.resize(32u);
+    }
+
+    void CellularAutomata::SetEngine(Engine engine)
+    {
+        this->engine = engine;
+    }
+
+    void CellularAutomata::SetInstructionSet(InstructionSet instructionSet)
+    {
+        this->instructionSet = std::min(instructionSet, supportedInstructionSet());
+    }
+
+    void CellularAutomata::SetThreadCount(uint32_t threadCount)
+    {
+        threadPool = threadCount > 1u ? std::make_shared<ThreadPool>(threadCount) : nullptr;
+    }
+
+    void CellularAutomata::SetThreadPool(std::shared_ptr<ThreadPool> threadPool)
+    {
+        this->threadPool = threadPool;
+    }
+
+    void CellularAutomata::SetTemporalBlocking(uint32_t tileSize)
+    {
+        temporalTileSize = tileSize;
+    }
+
+    void CellularAutomata::SetActivityTracking(uint32_t tileSize)
+    {
+        activityTileSize = tileSize;
+        trackedSteps = 0u;
+    }
+
+    uint32_t CellularAutomata::GetThreadCount() const
+    {
+        return threadPool ? threadPool->GetThreadCount() : 1u;
+    }
+
+    void CellularAutomata::SetBoundary(const Boundary& boundary)
+    {
+        this->boundary = boundary;
+        if (cells.GetHalo() != boundary.haloSize)
+        {
+            //The rows move when the halo changes size, so the cells are copied into a grid with the new halo:
+            nextCells.Resize(width, height, boundary.haloSize);
+            for (uint32_t y = 0u; y < height; y++)
+                std::copy_n(cells.Row(y), width, nextCells.Row(y));
+            std::swap(cells, nextCells);
+            nextCells.Resize(width, height, boundary.haloSize);
+        }
+        cells.UpdateHalo(boundary);
+        trackedSteps = 0u;
+        quadtreeReset = false;
+    }
+
+    const Boundary& CellularAutomata::GetBoundary() const
+    {
+        return boundary;
+    }
+
     void CellularAutomata::SetCell(uint32_t type, uint32_t x, uint32_t y)
     {
-        cells[GetIndex(x, y)] = { type, x, y };
+        cells.Set(type, x, y, boundary);
+        trackedSteps = 0u;
+        binaryCellsCurrent = false;
     }
 
-    const CellularAutomata::Cell& CellularAutomata::GetCell(uint32_t x, uint32_t y) const
+    CellularAutomata::Cell CellularAutomata::GetCell(uint32_t x, uint32_t y) const
     {
-        return cells[GetIndex(x, y)];
+        return { cells.Get(x, y), x, y };
     }
 
     uint32_t CellularAutomata::GetWidth() const
@@ -81,11 +188,13 @@ namespace pcg
         for (int32_t x0 = sx - sm; x0 <= sx + sm; x0++)
             for (int32_t y0 = sy - sm; y0 <= sy + sm; y0++)
             {
-                if (x0 >= 0 && x0 < width && y0 >= 0 && y0 < height)
+                int32_t x1 = x0;
+                int32_t y1 = y0;
+                if (boundary.Map(x1, static_cast<int32_t>(width)) && boundary.Map(y1, static_cast<int32_t>(height)))
                 {
-                    const auto& cell = GetCell(x0, y0);
-                    if (contains(cellTypes, cell.type))
-                        neighbourhood.push_back(cell);
+                    uint32_t type = cells.Get(x1, y1);
+                    if (contains(cellTypes, type))
+                        neighbourhood.push_back({ type, static_cast<uint32_t>(x1), static_cast<uint32_t>(y1) });
                 }
             }
         return neighbourhood;
@@ -106,92 +215,1186 @@ namespace pcg
         for (int32_t y0 = -sr; y0 <= sr; y0++)
         {
             int32_t y1 = sy + y0;
-            if (y1 < 0 || y1 >= height)
+            if (!boundary.Map(y1, static_cast<int32_t>(height)))
                 continue;
             int32_t d = std::abs(y0) - sr;
             for (int32_t x0 = d; x0 <= -d; x0++)
             {
                 int32_t x1 = sx + x0;
-                if (x1 < 0 || x1 >= width)
+                if (!boundary.Map(x1, static_cast<int32_t>(width)))
                     continue;
-                const auto& cell = GetCell(x1, y1);
-                if (contains(cellTypes, cell.type))
-                    neighbourhood.push_back(cell);
+                uint32_t type = cells.Get(x1, y1);
+                if (contains(cellTypes, type))
+                    neighbourhood.push_back({ type, static_cast<uint32_t>(x1), static_cast<uint32_t>(y1) });
             }
         }
         return neighbourhood;
     }
 
+    TypeMask::TypeMask(std::initializer_list<uint32_t> cellTypes)
+    {
+        //Types from 32 on cannot be part of the mask, like in Contains:
+        for (uint32_t cellType : cellTypes)
+            if (cellType < 32u)
+                bits |= 1u << cellType;
+    }
+
+    bool TypeMask::Contains(uint32_t cellType) const
+    {
+        return cellType < 32u && (bits >> cellType) & 1u;
+    }
+
+    //The type of a cell, which may be outside the grid:
+    static uint32_t sample(const CellularAutomata::Grid& cells, const Boundary& boundary, int32_t x, int32_t y)
+    {
+        if (!boundary.Map(x, static_cast<int32_t>(cells.GetWidth())) ||
+            !boundary.Map(y, static_cast<int32_t>(cells.GetHeight())))
+            return boundary.fillType;
+        return cells.Get(x, y);
+    }
+
+    template<typename Match>
+    static uint32_t mooreCount(
+        const CellularAutomata::Grid& cells,
+        const Boundary& boundary,
+        uint32_t x, uint32_t y,
+        uint32_t m,
+        Match match)
+    {
+        int32_t sx = static_cast<int32_t>(x);
+        int32_t sy = static_cast<int32_t>(y);
+        int32_t sm = static_cast<int32_t>(m);
+
+        uint32_t count = 0u;
+        if (m <= cells.GetHalo())
+        {
+            //Neighbours outside the grid are in the halo, so they are read without checking the edges:
+            for (int32_t y0 = sy - sm; y0 <= sy + sm; y0++)
+            {
+                const CellularAutomata::CellType* row = cells.Row(y0);
+                for (int32_t x0 = sx - sm; x0 <= sx + sm; x0++)
+                    count += match(row[x0]);
+            }
+            return count;
+        }
+        for (int32_t y0 = sy - sm; y0 <= sy + sm; y0++)
+            for (int32_t x0 = sx - sm; x0 <= sx + sm; x0++)
+                count += match(sample(cells, boundary, x0, y0));
+        return count;
+    }
+
+    template<typename Match>
+    static uint32_t vonNeumannCount(
+        const CellularAutomata::Grid& cells,
+        const Boundary& boundary,
+        uint32_t x, uint32_t y,
+        uint32_t r,
+        Match match)
+    {
+        int32_t sx = static_cast<int32_t>(x);
+        int32_t sy = static_cast<int32_t>(y);
+        int32_t sr = static_cast<int32_t>(r);
+        bool withinHalo = r <= cells.GetHalo();
+
+        uint32_t count = 0u;
+        for (int32_t y0 = -sr; y0 <= sr; y0++)
+        {
+            int32_t d = sr - std::abs(y0);
+            if (withinHalo)
+            {
+                const CellularAutomata::CellType* row = cells.Row(sy + y0);
+                for (int32_t x0 = sx - d; x0 <= sx + d; x0++)
+                    count += match(row[x0]);
+            }
+            else
+            {
+                for (int32_t x0 = sx - d; x0 <= sx + d; x0++)
+                    count += match(sample(cells, boundary, x0, sy + y0));
+            }
+        }
+        return count;
+    }
+
+    uint32_t CellularAutomata::MooreCount(
+        uint32_t x, uint32_t y, uint32_t m, uint32_t cellType) const
+    {
+        //The tables cover the halo, so positions within them are shifted by the size of the halo.
+        uint32_t halo = cells.GetHalo();
+        if (tablesBuilt && m <= halo && countedTypes.Contains(cellType))
+            return tables[cellType].Count(x + halo - m, y + halo - m, x + halo + m, y + halo + m);
+        return mooreCount(cells, boundary, x, y, m, [cellType](uint32_t type) { return type == cellType; });
+    }
+
+    uint32_t CellularAutomata::MooreCount(
+        uint32_t x, uint32_t y, uint32_t m, TypeMask cellTypes) const
+    {
+        if (tablesBuilt && m <= cells.GetHalo() && (cellTypes.bits & ~countedTypes.bits) == 0u)
+        {
+            uint32_t count = 0u;
+            for (uint32_t bits = cellTypes.bits; bits != 0u; bits &= bits - 1u)
+                count += MooreCount(x, y, m, static_cast<uint32_t>(std::countr_zero(bits)));
+            return count;
+        }
+        return mooreCount(cells, boundary, x, y, m, [cellTypes](uint32_t type) { return cellTypes.Contains(type); });
+    }
+
+    uint32_t CellularAutomata::VonNeumannCount(
+        uint32_t x, uint32_t y, uint32_t r, uint32_t cellType) const
+    {
+        return vonNeumannCount(cells, boundary, x, y, r, [cellType](uint32_t type) { return type == cellType; });
+    }
+
+    uint32_t CellularAutomata::VonNeumannCount(
+        uint32_t x, uint32_t y, uint32_t r, TypeMask cellTypes) const
+    {
+        return vonNeumannCount(cells, boundary, x, y, r, [cellTypes](uint32_t type) { return cellTypes.Contains(type); });
+    }
+
     void CellularAutomata::Step()
     {
-        std::vector<Cell> newCells;
-        newCells.resize(cells.size());
+        if (StepTracked())
+            return;
+        trackedSteps = 0u;
+        if (!StepThreshold(1u))
+            StepFunction();
+    }
+
+    //Flags of tileChanges. The first compares with the previous generation, the second with the one before it.
+    static constexpr uint8_t changedInLastStep = 1u;
+    static constexpr uint8_t changedInTwoSteps = 2u;
 
-        for (uint32_t x = 0; x < width; x++)
+    bool CellularAutomata::StepTracked()
+    {
+        //Rule functions may depend on more than the neighbourhood, so only declarative rules can skip tiles.
+        if (activityTileSize == 0u || !declarativeRule)
+            return false;
+        if (engine != Engine::Automatic && engine != Engine::Bytes && engine != Engine::Compiled)
+            return false;
+        const OuterTotalisticRule& r = *declarativeRule;
+        uint32_t maxType = std::numeric_limits<CellType>::max();
+        if (r.m > maxCompiledRadius || r.m > cells.GetHalo() || r.countedType > maxType || ruleTable.MaxNextType() > maxType)
+            return false;
+        //Runs of active tiles are stepped by the byte kernels, unless the compiled kernels were selected:
+        const ByteRule* byteRunRule = engine != Engine::Compiled && byteRule ? &*byteRule : nullptr;
+
+        uint32_t tileSize = activityTileSize;
+        uint32_t tilesX = (width + tileSize - 1u) / tileSize;
+        uint32_t tilesY = (height + tileSize - 1u) / tileSize;
+        size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+        if (tileChanges.size() != tileCount)
+            trackedSteps = 0u;
+        tileChanges.resize(tileCount);
+        nextTileChanges.resize(tileCount);
+        activeTiles.resize(tileCount);
+        olderCells.Resize(width, height, cells.GetHalo());
+        byteColumnCounts.resize(GetThreadCount());
+
+        //A tile is active if a tile within reach of its neighbourhood changed in the last step.
+        //A wrapping neighbourhood can reach past a partial tile at the far edge into the tile before it.
+        bool wrap = boundary.policy == BoundaryPolicy::Wrap;
+        int32_t reach = static_cast<int32_t>((r.m + tileSize - 1u) / tileSize);
+        int32_t reachX = reach + (wrap && width % tileSize != 0u ? 1 : 0);
+        int32_t reachY = reach + (wrap && height % tileSize != 0u ? 1 : 0);
+        int32_t sTilesX = static_cast<int32_t>(tilesX);
+        int32_t sTilesY = static_cast<int32_t>(tilesY);
+        for (int32_t ty = 0; ty < sTilesY; ty++)
+            for (int32_t tx = 0; tx < sTilesX; tx++)
+            {
+                bool active = trackedSteps == 0u;
+                for (int32_t dy = -reachY; dy <= reachY && !active; dy++)
+                    for (int32_t dx = -reachX; dx <= reachX && !active; dx++)
+                    {
+                        int32_t nx = tx + dx;
+                        int32_t ny = ty + dy;
+                        if (nx < 0 || nx >= sTilesX || ny < 0 || ny >= sTilesY)
+                        {
+                            if (!wrap)
+                                continue;
+                            nx = (nx % sTilesX + sTilesX) % sTilesX;
+                            ny = (ny % sTilesY + sTilesY) % sTilesY;
+                        }
+                        active = tileChanges[nx + static_cast<size_t>(ny) * tilesX] & changedInLastStep;
+                    }
+                activeTiles[tx + static_cast<size_t>(ty) * tilesX] = active;
+            }
+
+        //The next generation is written over olderCells, so nextCells still holds the previous generation to compare with.
+        bool previousKnown = trackedSteps > 0u;
+        TableFunction function(ruleTable);
+        std::function<ThreadPool::RangeFunction> stepTileRows = [&](uint32_t worker, uint32_t begin, uint32_t end)
         {
-            for (uint32_t y = 0; y < height; y++)
+            for (uint32_t ty = begin; ty < end; ty++)
             {
-                uint32_t newCell = rule(*this, x, y);
-                newCells[GetIndex(x, y)] = { newCell, x, y };
+                uint32_t y0 = ty * tileSize;
+                uint32_t y1 = std::min(y0 + tileSize, height);
+                const uint8_t* active = &activeTiles[static_cast<size_t>(ty) * tilesX];
+                for (uint32_t tx = 0u; byteRunRule && tx < tilesX;)
+                {
+                    uint32_t runEnd = tx;
+                    while (runEnd < tilesX && active[runEnd])
+                        runEnd++;
+                    if (runEnd > tx)
+                        stepByteRule(
+                            cells.GetView(), olderCells, *byteRunRule,
+                            y0, y1,
+                            byteColumnCounts[worker], instructionSet,
+                            tx * tileSize, runEnd * tileSize);
+                    tx = runEnd + 1u;
+                }
+
+                for (uint32_t tx = 0u; tx < tilesX; tx++)
+                {
+                    size_t tile = tx + static_cast<size_t>(ty) * tilesX;
+                    uint32_t x0 = tx * tileSize;
+                    uint32_t x1 = std::min(x0 + tileSize, width);
+                    if (!active[tx])
+                    {
+                        //The tile is the same as two steps ago, and thus already in olderCells, unless it changed in the step before.
+                        if (tileChanges[tile] & changedInTwoSteps)
+                            for (uint32_t y = y0; y < y1; y++)
+                                std::copy(cells.Row(y) + x0, cells.Row(y) + x1, olderCells.Row(y) + x0);
+                        nextTileChanges[tile] = 0u;
+                        continue;
+                    }
+                    if (!byteRunRule)
+                        (void)stepRowsCompiled<ReadHalo>(
+                            r.neighbourhood, r.m,
+                            cells.GetView(), olderCells,
+                            r.countedType, function,
+                            y0, y1, x0, x1);
+
+                    //Rows are compared until both kinds of change are found:
+                    uint8_t changes = previousKnown ? 0u : changedInTwoSteps;
+                    for (uint32_t y = y0; y < y1 && changes != (changedInLastStep | changedInTwoSteps); y++)
+                    {
+                        const CellType* row = olderCells.Row(y);
+                        if (!(changes & changedInLastStep) && !std::equal(row + x0, row + x1, cells.Row(y) + x0))
+                            changes |= changedInLastStep;
+                        if (!(changes & changedInTwoSteps) && !std::equal(row + x0, row + x1, nextCells.Row(y) + x0))
+                            changes |= changedInTwoSteps;
+                    }
+                    nextTileChanges[tile] = changes;
+                }
             }
+        };
+        if (threadPool)
+            threadPool->ParallelFor(0u, tilesY, 1u, stepTileRows);
+        else
+            stepTileRows(0u, 0u, tilesY);
+
+        //Rotates the generations, so cells holds the new one, nextCells the previous one and olderCells the one before it:
+        std::swap(olderCells, nextCells);
+        std::swap(nextCells, cells);
+        std::swap(tileChanges, nextTileChanges);
+        cells.UpdateHalo(boundary);
+        binaryCellsCurrent = false;
+        trackedSteps++;
+        return true;
+    }
+
+    void CellularAutomata::TrackUniformTiles()
+    {
+        trackedSteps = 0u;
+        if (activityTileSize == 0u || !declarativeRule || declarativeRule->m > cells.GetHalo())
+            return;
+        const OuterTotalisticRule& r = *declarativeRule;
+        uint32_t fullCount = neighbourhoodSize(r.neighbourhood, r.m);
+        int32_t m = static_cast<int32_t>(r.m);
+
+        uint32_t tileSize = activityTileSize;
+        uint32_t tilesX = (width + tileSize - 1u) / tileSize;
+        uint32_t tilesY = (height + tileSize - 1u) / tileSize;
+        size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+        tileChanges.resize(tileCount);
+        nextTileChanges.resize(tileCount);
+        activeTiles.resize(tileCount);
+        olderCells.Resize(width, height, cells.GetHalo());
+
+        //A tile is kept if its cells and the halo within reach of them are of one type, which the rule keeps when surrounded by itself.
+        //Every tile is flagged as changed two steps ago, so a skipped tile is copied into olderCells.
+        std::function<ThreadPool::RangeFunction> checkTileRows = [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            for (uint32_t ty = begin; ty < end; ty++)
+            {
+                int32_t y0 = static_cast<int32_t>(ty * tileSize) - m;
+                int32_t y1 = static_cast<int32_t>(std::min((ty + 1u) * tileSize, height)) + m;
+                for (uint32_t tx = 0u; tx < tilesX; tx++)
+                {
+                    int32_t x0 = static_cast<int32_t>(tx * tileSize) - m;
+                    int32_t x1 = static_cast<int32_t>(std::min((tx + 1u) * tileSize, width)) + m;
+                    CellType type = cells.Row(y0)[x0];
+                    //The differences of a row are combined without branches, so the comparisons are vectorized:
+                    CellType differences = 0u;
+                    for (int32_t y = y0; y < y1 && differences == 0u; y++)
+                    {
+                        const CellType* row = cells.Row(y);
+                        for (int32_t x = x0; x < x1; x++)
+                            differences |= static_cast<CellType>(row[x] ^ type);
+                    }
+                    bool uniform = differences == 0u && ruleTable.Get(type, type == r.countedType ? fullCount : 0u) == type;
+                    nextTileChanges[tx + static_cast<size_t>(ty) * tilesX] = changedInTwoSteps | (uniform ? 0u : changedInLastStep);
+                }
+            }
+        };
+        if (threadPool)
+            threadPool->ParallelFor(0u, tilesY, 1u, checkTileRows);
+        else
+            checkTileRows(0u, 0u, tilesY);
+
+        //The previous generation is made equal to the cells, so both flags of the next step compare with them:
+        std::swap(tileChanges, nextTileChanges);
+        nextCells.Assign(cells.GetView());
+        trackedSteps = 1u;
+    }
+
+    CellularAutomata::Convergence CellularAutomata::GetConvergence() const
+    {
+        if (trackedSteps == 0u)
+            return Convergence::None;
+        auto unchanged = [this](uint8_t flag)
+        {
+            return std::none_of(tileChanges.begin(), tileChanges.end(), [flag](uint8_t changes) { return changes & flag; });
+        };
+        if (unchanged(changedInLastStep))
+            return Convergence::FixedPoint;
+        //The second flag compares with the generation before the previous one, which is only known after two steps.
+        if (trackedSteps > 1u && unchanged(changedInTwoSteps))
+            return Convergence::Cycle;
+        return Convergence::None;
+    }
+
+    bool CellularAutomata::StepThreshold(uint32_t n)
+    {
+        if (engine == Engine::Quadtree && StepQuadtree(n))
+            return true;
+        //The byte kernels are the fastest for the radii they support. The bit kernels cover larger radii.
+        if ((engine == Engine::Automatic || engine == Engine::Bytes) && StepBytes(n))
+            return true;
+        if ((engine == Engine::Automatic || engine == Engine::Bits) && StepBinary(n))
+            return true;
+        if ((engine == Engine::Automatic || engine == Engine::Compiled) && StepCompiled(n))
+            return true;
+        if ((engine == Engine::Automatic || engine == Engine::Histogram) && StepHistogram(n))
+            return true;
+        return false;
+    }
+
+    bool CellularAutomata::StepHistogram(uint32_t n)
+    {
+        if (!histogramRule || n == 0u || histogramRule->m > cells.GetHalo())
+            return false;
+        const HistogramRule& r = *histogramRule;
+
+        histogramColumnCounts.resize(GetThreadCount());
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            nextCells.Resize(width, height);
+            ForEachBand(2u * r.m, [&](uint32_t worker, uint32_t rowBegin, uint32_t rowEnd)
+                {
+                    stepHistogramRule(
+                        cells.GetView(), nextCells, r,
+                        rowBegin, rowEnd,
+                        histogramColumnCounts[worker]);
+                });
+            std::swap(cells, nextCells);
+            cells.UpdateHalo(boundary);
+            binaryCellsCurrent = false;
+        }
+        return true;
+    }
+
+    std::optional<CellularAutomata::BitRule> CellularAutomata::GetBitRule() const
+    {
+        if (!declarativeRule)
+            return std::nullopt;
+        const OuterTotalisticRule& r = *declarativeRule;
+        if (r.neighbourhood != Neighbourhood::Moore || r.m > BinaryGrid::maxRadius)
+            return std::nullopt;
+
+        //Set bits are cells of the counted type. The other type is the one the counted type can turn into.
+        uint32_t countedType = r.countedType;
+        auto countedRow = ruleTable.RowInterval(countedType);
+        if (!countedRow)
+            return std::nullopt;
+        uint32_t otherType = countedRow->typeInside != countedType ? countedRow->typeInside : countedRow->typeOutside;
+        auto otherRow = ruleTable.RowInterval(otherType);
+        if (otherType == countedType || !otherRow)
+            return std::nullopt;
+        auto producesTwoTypes = [countedType, otherType](const RuleTable::Interval& interval)
+        {
+            return
+                (interval.typeInside == countedType || interval.typeInside == otherType) &&
+                (interval.typeOutside == countedType || interval.typeOutside == otherType);
+        };
+        if (!producesTwoTypes(*countedRow) || !producesTwoTypes(*otherRow))
+            return std::nullopt;
+        auto toBits = [countedType](const RuleTable::Interval& interval)
+        {
+            return BitTransition
+            {
+                interval.minCount,
+                interval.maxCount,
+                interval.typeInside == countedType,
+                interval.typeOutside == countedType
+            };
+        };
+        return BitRule
+        {
+            .m = r.m,
+            .countedType = countedType,
+            .otherType = otherType,
+            .setBits = toBits(*countedRow),
+            .clearedBits = toBits(*otherRow)
+        };
+    }
+
+    bool CellularAutomata::StepBinary(uint32_t n)
+    {
+        if (n == 0u)
+            return false;
+        auto bitRule = GetBitRule();
+        if (!bitRule)
+            return false;
+        const BitRule& r = *bitRule;
+        uint32_t countedType = r.countedType;
+        uint32_t otherType = r.otherType;
+        //The bit kernels count nothing outside the grid:
+        if (boundary.policy != BoundaryPolicy::Fill || boundary.fillType == countedType)
+            return false;
+        const BitTransition& setBits = r.setBits;
+        const BitTransition& clearedBits = r.clearedBits;
+        bool packed = binaryCellsCurrent && binaryOneType == countedType && binaryZeroType == otherType;
+        if (!packed && !binaryCells.Pack(cells.GetView(), countedType, otherType))
+            return false;
+
+        bitColumnCounts.resize(GetThreadCount());
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            nextBinaryCells.Resize(width, height);
+            ForEachBand(1u, [&](uint32_t worker, uint32_t rowBegin, uint32_t rowEnd)
+                {
+                    nextBinaryCells.Step(
+                        binaryCells, r.m,
+                        setBits, clearedBits,
+                        rowBegin, rowEnd,
+                        bitColumnCounts[worker]);
+                });
+            std::swap(binaryCells, nextBinaryCells);
         }
-        cells = std::move(newCells);
+        binaryCells.Unpack(cells, countedType, otherType);
+        cells.UpdateHalo(boundary);
+        binaryCellsCurrent = true;
+        binaryOneType = countedType;
+        binaryZeroType = otherType;
+        return true;
+    }
+
+    bool CellularAutomata::StepBytes(uint32_t n)
+    {
+        if (!byteRule || n == 0u || byteRule->m > cells.GetHalo())
+            return false;
+        const ByteRule& r = *byteRule;
+
+        byteColumnCounts.resize(GetThreadCount());
+        if (n > 1u && temporalTileSize > 0u && (width > temporalTileSize || height > temporalTileSize))
+        {
+            StepBytesTiled(r, n);
+            return true;
+        }
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            nextCells.Resize(width, height);
+            //Every band recounts the m rows above it, so bands are kept several times higher than that.
+            ForEachBand(4u * r.m, [&](uint32_t worker, uint32_t rowBegin, uint32_t rowEnd)
+                {
+                    stepByteRule(
+                        cells.GetView(), nextCells, r,
+                        rowBegin, rowEnd,
+                        byteColumnCounts[worker], instructionSet);
+                });
+            std::swap(cells, nextCells);
+            cells.UpdateHalo(boundary);
+            binaryCellsCurrent = false;
+        }
+        return true;
+    }
+
+    bool CellularAutomata::StepCompiled(uint32_t n)
+    {
+        if (!declarativeRule || n == 0u)
+            return false;
+        const OuterTotalisticRule& r = *declarativeRule;
+        uint32_t maxType = std::numeric_limits<CellType>::max();
+        if (r.m > maxCompiledRadius || r.m > cells.GetHalo() || r.countedType > maxType || ruleTable.MaxNextType() > maxType)
+            return false;
+
+        TableFunction function(ruleTable);
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            nextCells.Resize(width, height);
+            ForEachBand(1u, [&](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+                {
+                    //The radius was checked above, so this always finds a kernel.
+                    (void)stepRowsCompiled<ReadHalo>(
+                        r.neighbourhood, r.m,
+                        cells.GetView(), nextCells,
+                        r.countedType, function,
+                        rowBegin, rowEnd);
+                });
+            std::swap(cells, nextCells);
+            cells.UpdateHalo(boundary);
+            binaryCellsCurrent = false;
+        }
+        return true;
+    }
+
+    bool CellularAutomata::StepQuadtree(uint32_t n)
+    {
+        if (!declarativeRule || n == 0u)
+            return false;
+        //Cells outside the grid are stored as void nodes, which must never change.
+        if (boundary.policy != BoundaryPolicy::Fill || ruleTable.MaxNextType() >= voidType)
+            return false;
+
+        if (!quadtreeReset)
+        {
+            quadtree.Reset(*declarativeRule, ruleTable, boundary.fillType);
+            quadtreeReset = true;
+        }
+        quadtree.Advance(cells, n);
+        cells.UpdateHalo(boundary);
+        binaryCellsCurrent = false;
+        return true;
+    }
+
+    void CellularAutomata::StepBytesTiled(const ByteRule& rule, uint32_t n)
+    {
+        //Cells within the halo are wrong after n steps only if they are affected by the missing cells outside it.
+        //Errors spread m cells per step, so the tile itself is exact after n steps.
+        uint32_t halo = n * rule.m;
+        uint32_t tileSize = temporalTileSize;
+        uint32_t tilesX = (width + tileSize - 1u) / tileSize;
+        uint32_t tilesY = (height + tileSize - 1u) / tileSize;
+        tileBuffers.resize(GetThreadCount());
+        nextCells.Resize(width, height);
+
+        //A wrapping grid has no edges, so tiles read their halo from the opposite side and are never clipped.
+        //Otherwise tiles are clipped against the grid and their own halos reproduce the boundary at its edges.
+        bool wrap = boundary.policy == BoundaryPolicy::Wrap;
+        Boundary tileBoundary = wrap ? Boundary{} : boundary;
+        int32_t sw = static_cast<int32_t>(width);
+        int32_t sHeight = static_cast<int32_t>(height);
+        int32_t sHalo = static_cast<int32_t>(halo);
+
+        std::function<ThreadPool::RangeFunction> stepTiles = [&](uint32_t worker, uint32_t begin, uint32_t end)
+        {
+            auto& [tile, nextTile] = tileBuffers[worker];
+            for (uint32_t i = begin; i < end; i++)
+            {
+                int32_t x0 = static_cast<int32_t>((i % tilesX) * tileSize);
+                int32_t y0 = static_cast<int32_t>((i / tilesX) * tileSize);
+                int32_t x1 = std::min(x0 + static_cast<int32_t>(tileSize), sw);
+                int32_t y1 = std::min(y0 + static_cast<int32_t>(tileSize), sHeight);
+                int32_t haloX0 = wrap ? x0 - sHalo : std::max(x0 - sHalo, 0);
+                int32_t haloY0 = wrap ? y0 - sHalo : std::max(y0 - sHalo, 0);
+                int32_t haloX1 = wrap ? x1 + sHalo : std::min(x1 + sHalo, sw);
+                int32_t haloY1 = wrap ? y1 + sHalo : std::min(y1 + sHalo, sHeight);
+                uint32_t tileWidth = static_cast<uint32_t>(haloX1 - haloX0);
+                uint32_t tileHeight = static_cast<uint32_t>(haloY1 - haloY0);
+
+                tile.Resize(tileWidth, tileHeight, rule.m);
+                nextTile.Resize(tileWidth, tileHeight, rule.m);
+                for (int32_t y = haloY0; y < haloY1; y++)
+                {
+                    int32_t sourceY = y;
+                    (void)boundary.Map(sourceY, sHeight);
+                    CellType* tileRow = tile.Row(y - haloY0);
+                    //Copies runs of cells, which only end at the right edge of the grid when wrapping:
+                    for (int32_t x = haloX0; x < haloX1;)
+                    {
+                        int32_t sourceX = x;
+                        (void)boundary.Map(sourceX, sw);
+                        int32_t run = std::min(haloX1 - x, sw - sourceX);
+                        std::copy_n(cells.Row(sourceY) + sourceX, run, tileRow + (x - haloX0));
+                        x += run;
+                    }
+                }
+
+                //Rows further than (n - 1 - step) * m from the tile are not needed by later steps and are skipped.
+                for (uint32_t step = 0u; step < n; step++)
+                {
+                    uint32_t needed = (n - 1u - step) * rule.m;
+                    uint32_t top = static_cast<uint32_t>(y0 - haloY0);
+                    uint32_t rowBegin = top > needed ? top - needed : 0u;
+                    uint32_t rowEnd = std::min(top + static_cast<uint32_t>(y1 - y0) + needed, tileHeight);
+                    tile.UpdateHalo(tileBoundary);
+                    stepByteRule(
+                        tile.GetView(), nextTile, rule,
+                        rowBegin, rowEnd,
+                        byteColumnCounts[worker], instructionSet);
+                    std::swap(tile, nextTile);
+                }
+
+                for (int32_t y = y0; y < y1; y++)
+                    std::copy_n(tile.Row(y - haloY0) + (x0 - haloX0), x1 - x0, nextCells.Row(y) + x0);
+            }
+        };
+        if (threadPool)
+            threadPool->ParallelFor(0u, tilesX * tilesY, 1u, stepTiles);
+        else
+            stepTiles(0u, 0u, tilesX * tilesY);
+        std::swap(cells, nextCells);
+        cells.UpdateHalo(boundary);
+        binaryCellsCurrent = false;
+    }
+
+    void CellularAutomata::ForEachBand(uint32_t minRows, const std::function<ThreadPool::RangeFunction>& stepRows)
+    {
+        ForEachBand(height, width, minRows, stepRows);
+    }
+
+    void CellularAutomata::ForEachBand(
+        uint32_t rowCount, uint32_t rowWidth, uint32_t minRows,
+        const std::function<ThreadPool::RangeFunction>& stepRows)
+    {
+        //Bands smaller than this cost more in synchronization than they gain:
+        static constexpr uint32_t minBandCells = 16384u;
+        minRows = std::max(minRows, minBandCells / std::max(rowWidth, 1u));
+        if (threadPool)
+            threadPool->ParallelFor(0u, rowCount, minRows, stepRows);
+        else
+            stepRows(0u, 0u, rowCount);
+    }
+
+    void CellularAutomata::StepFunction()
+    {
+        //The back buffer keeps its capacity between steps, so no allocation happens after the first step.
+        nextCells.Resize(width, height);
+
+        if (countingMode == CountingMode::SummedAreaTable)
+        {
+            //The tables include the halo, so counts near the edges follow the boundary:
+            for (uint32_t bits = countedTypes.bits; bits != 0u; bits &= bits - 1u)
+            {
+                uint32_t cellType = static_cast<uint32_t>(std::countr_zero(bits));
+                tables[cellType].Build(cells.GetView().WithHalo(), cellType);
+            }
+            tablesBuilt = true;
+        }
+
+        ForEachBand(1u, [this](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+            {
+                for (uint32_t y = rowBegin; y < rowEnd; y++)
+                {
+                    CellType* row = nextCells.Row(y);
+                    for (uint32_t x = 0; x < width; x++)
+                        row[x] = static_cast<CellType>(rule(*this, x, y));
+                }
+            });
+        //The tables describe the previous generation from here on:
+        tablesBuilt = false;
+        std::swap(cells, nextCells);
+        cells.UpdateHalo(boundary);
+        binaryCellsCurrent = false;
     }
 
     void CellularAutomata::Generate(uint32_t n)
     {
+        stepsPerformed = 0u;
+        if (n > 0u && StepTracked())
+        {
+            for (stepsPerformed = 1u; stepsPerformed < n; stepsPerformed++)
+            {
+                Convergence convergence = GetConvergence();
+                if (convergence == Convergence::FixedPoint)
+                    return;
+                if (convergence == Convergence::Cycle)
+                {
+                    //The remaining steps alternate between the two generations, so only their parity matters:
+                    if ((n - stepsPerformed) % 2u == 1u)
+                    {
+                        std::swap(cells, nextCells);
+                        cells.UpdateHalo(boundary);
+                        trackedSteps = 0u;
+                    }
+                    return;
+                }
+                (void)StepTracked();
+            }
+            return;
+        }
+
+        stepsPerformed = n;
+        trackedSteps = 0u;
+        if (StepThreshold(n))
+            return;
         for (size_t i = 0; i < n; i++)
-            Step();
+            StepFunction();
+    }
+
+    uint32_t CellularAutomata::GetStepsPerformed() const
+    {
+        return stepsPerformed;
     }
 
     void CellularAutomata::Initialize()
     {
-        for (uint32_t y = 0; y < height; y++)
-            for (uint32_t x = 0; x < width; x++)
-                cells[GetIndex(x, y)] = { initializer(*this, x, y), x, y };
+        trackedSteps = 0u;
+        binaryCellsCurrent = false;
+        ForEachBand(1u, [this](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+            {
+                for (uint32_t y = rowBegin; y < rowEnd; y++)
+                {
+                    CellType* row = cells.Row(y);
+                    for (uint32_t x = 0; x < width; x++)
+                        row[x] = static_cast<CellType>(initializer(*this, x, y));
+                }
+            });
+        cells.UpdateHalo(boundary);
     }
 
-    std::vector<CellularAutomata::Cell> CellularAutomata::Scale(
-        const std::vector<Cell>& cells,
-        uint32_t width, uint32_t height, uint32_t multiplier) const
+    void CellularAutomata::Scale(
+        const Grid& cells, Grid& scaledCells, uint32_t multiplier) const
     {
-        uint32_t scaledWidth = width * multiplier;
-        uint32_t scaledHeight = height * multiplier;
-        std::vector<Cell> newCells;
-        newCells.resize(scaledWidth * scaledHeight);
+        uint32_t scaledWidth = cells.GetWidth() * multiplier;
+        uint32_t scaledHeight = cells.GetHeight() * multiplier;
+        scaledCells.Resize(scaledWidth, scaledHeight);
 
         for (uint32_t y = 0u; y < scaledHeight; y++)
         {
+            const CellType* row = cells.Row(y / multiplier);
+            CellType* scaledRow = scaledCells.Row(y);
             for (uint32_t x = 0u; x < scaledWidth; x++)
-            {
-                uint32_t x0 = x / multiplier;
-                uint32_t y0 = y / multiplier;
-                newCells[getIndex(x, y, scaledWidth)] = cells[getIndex(x0, y0, width)];
-            }
+                scaledRow[x] = row[x / multiplier];
         }
-        return newCells;
     }
 
     void CellularAutomata::Scale(uint32_t multiplier)
     {
-        cells = Scale(cells, width, height, multiplier);
+        if (binaryCellsCurrent)
+        {
+            //The packed cells are scaled too, so they stay current for the next step on the bit engine.
+            nextBinaryCells.Scale(binaryCells, multiplier, instructionSet);
+            std::swap(binaryCells, nextBinaryCells);
+            binaryCells.Unpack(cells, binaryOneType, binaryZeroType);
+        }
+        else
+        {
+            Scale(cells, nextCells, multiplier);
+            std::swap(cells, nextCells);
+        }
+        trackedSteps = 0u;
+        cells.UpdateHalo(boundary);
         width *= multiplier;
         height *= multiplier;
+        originX *= multiplier;
+        originY *= multiplier;
+    }
+
+    void CellularAutomata::Refine(uint32_t multiplier, const std::function<RefineFunction>& refine)
+    {
+        uint32_t scaledWidth = width * multiplier;
+        uint32_t scaledHeight = height * multiplier;
+        nextCells.Resize(scaledWidth, scaledHeight);
+        binaryCellsCurrent = false;
+
+        ForEachBand(scaledHeight, scaledWidth, 1u, [&](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+            {
+                for (uint32_t y = rowBegin; y < rowEnd; y++)
+                {
+                    const CellType* row = cells.Row(y / multiplier);
+                    CellType* scaledRow = nextCells.Row(y);
+                    for (uint32_t parentX = 0u, x = 0u; parentX < width; parentX++)
+                    {
+                        uint32_t parentType = row[parentX];
+                        for (uint32_t i = 0u; i < multiplier; i++, x++)
+                            scaledRow[x] = static_cast<CellType>(refine(*this, parentType, x, y));
+                    }
+                }
+            });
+
+        std::swap(cells, nextCells);
+        trackedSteps = 0u;
+        cells.UpdateHalo(boundary);
+        width = scaledWidth;
+        height = scaledHeight;
+        originX *= multiplier;
+        originY *= multiplier;
+    }
+
+    //Writes oneType for the set bits and zeroType for the cleared bits of a packed row.
+    static void unpackRow(const uint64_t* bits, uint8_t* row, uint32_t width, uint8_t oneType, uint8_t zeroType)
+    {
+        for (uint32_t x = 0u; x < width; x++)
+            row[x] = (bits[x / 64u] >> (x % 64u)) & 1ull ? oneType : zeroType;
+    }
+
+    void CellularAutomata::InitializeRandom(
+        const CellRandom& random, uint32_t percent, uint32_t chosenType, uint32_t otherType)
+    {
+        trackedSteps = 0u;
+        binaryCells.Resize(width, height);
+        uint32_t wordsPerRow = binaryCells.GetWordsPerRow();
+        uint64_t lastWordMask = binaryCells.LastWordMask();
+        if (wordsPerRow > 0u)
+            ForEachBand(1u, [&](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+                {
+                    for (uint32_t y = rowBegin; y < rowEnd; y++)
+                    {
+                        uint64_t* bits = binaryCells.Row(y);
+                        percentMasks(
+                            random, static_cast<uint32_t>(originY + y), percent, 0u,
+                            bits, wordsPerRow, instructionSet, static_cast<uint32_t>(originX));
+                        bits[wordsPerRow - 1u] &= lastWordMask;
+                        unpackRow(
+                            bits, cells.Row(y), width,
+                            static_cast<CellType>(chosenType), static_cast<CellType>(otherType));
+                    }
+                });
+        cells.UpdateHalo(boundary);
+        //The bits written are the cells packed with chosenType as set bits:
+        binaryCellsCurrent = chosenType != otherType;
+        binaryOneType = chosenType;
+        binaryZeroType = otherType;
+    }
+
+    void CellularAutomata::RefineRandom(
+        uint32_t multiplier, const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType)
+    {
+        RefineRandom(multiplier, random, percent, firstType, secondType, nullptr);
+    }
+
+    void CellularAutomata::RefineRandom(
+        uint32_t multiplier, const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType,
+        const BinaryGrid* flippable)
+    {
+        uint32_t scaledWidth = width * multiplier;
+        uint32_t scaledHeight = height * multiplier;
+        uint32_t wordsPerRow = (scaledWidth + 63u) / 64u;
+        bool packed =
+            binaryCellsCurrent &&
+            ((binaryOneType == firstType && binaryZeroType == secondType) ||
+            (binaryOneType == secondType && binaryZeroType == firstType));
+
+        //The random values are those of the coordinates of the cells after the origin is scaled.
+        //They are only computed for the words with a flippable cell:
+        int64_t scaledOriginX = originX * multiplier;
+        int64_t scaledOriginY = originY * multiplier;
+        auto computeMasks = [&](uint32_t y, std::vector<uint64_t>& masks)
+        {
+            uint32_t randomX = static_cast<uint32_t>(scaledOriginX);
+            uint32_t randomY = static_cast<uint32_t>(scaledOriginY + y);
+            if (!flippable)
+            {
+                percentMasks(random, randomY, percent, 0u, masks.data(), wordsPerRow, instructionSet, randomX);
+                return;
+            }
+            const uint64_t* flippableRow = flippable->Row(y);
+            for (uint32_t word = 0u; word < wordsPerRow;)
+            {
+                uint32_t runEnd = word;
+                while (runEnd < wordsPerRow && flippableRow[runEnd] != 0ull)
+                    runEnd++;
+                if (runEnd > word)
+                    percentMasks(random, randomY, percent, 0u, &masks[word], runEnd - word, instructionSet, randomX + word * 64u);
+                for (; word < runEnd; word++)
+                    masks[word] &= flippableRow[word];
+                if (word < wordsPerRow)
+                    masks[word++] = 0ull;
+            }
+        };
+
+        if (packed)
+        {
+            //Both types are flipped into each other, so flipping the packed cells is a xor with the mask of chosen cells.
+            nextBinaryCells.Scale(binaryCells, multiplier, instructionSet);
+            std::swap(binaryCells, nextBinaryCells);
+            cells.Resize(scaledWidth, scaledHeight);
+            uint64_t lastWordMask = binaryCells.LastWordMask();
+            if (wordsPerRow > 0u)
+                ForEachBand(scaledHeight, scaledWidth, 1u, [&](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+                    {
+                        std::vector<uint64_t> masks(wordsPerRow);
+                        for (uint32_t y = rowBegin; y < rowEnd; y++)
+                        {
+                            computeMasks(y, masks);
+                            uint64_t* bits = binaryCells.Row(y);
+                            for (uint32_t word = 0u; word < wordsPerRow; word++)
+                                bits[word] ^= masks[word];
+                            bits[wordsPerRow - 1u] &= lastWordMask;
+                            unpackRow(
+                                bits, cells.Row(y), scaledWidth,
+                                static_cast<CellType>(binaryOneType), static_cast<CellType>(binaryZeroType));
+                        }
+                    });
+        }
+        else
+        {
+            nextCells.Resize(scaledWidth, scaledHeight);
+            ForEachBand(scaledHeight, scaledWidth, 1u, [&](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+                {
+                    std::vector<uint64_t> masks(wordsPerRow);
+                    for (uint32_t y = rowBegin; y < rowEnd; y++)
+                    {
+                        computeMasks(y, masks);
+                        const CellType* row = cells.Row(y / multiplier);
+                        CellType* scaledRow = nextCells.Row(y);
+                        for (uint32_t parentX = 0u, x = 0u; parentX < width; parentX++)
+                        {
+                            CellType parentType = row[parentX];
+                            CellType flippedType = static_cast<CellType>(parentType == firstType ? secondType : firstType);
+                            for (uint32_t i = 0u; i < multiplier; i++, x++)
+                                scaledRow[x] = (masks[x / 64u] >> (x % 64u)) & 1ull ? flippedType : parentType;
+                        }
+                    }
+                });
+            std::swap(cells, nextCells);
+        }
+
+        trackedSteps = 0u;
+        cells.UpdateHalo(boundary);
+        width = scaledWidth;
+        height = scaledHeight;
+        originX = scaledOriginX;
+        originY = scaledOriginY;
+    }
+
+    void CellularAutomata::RefineBorders(
+        uint32_t multiplier,
+        const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType,
+        uint32_t radius)
+    {
+        //A parent is near a border if the smallest and largest types within the radius differ.
+        //The window is taken along the rows and then along the columns, with whole rows at a time so the loops are vectorized.
+        size_t cellCount = static_cast<size_t>(width) * height;
+        std::vector<CellType> rowMin(cellCount);
+        std::vector<CellType> rowMax(cellCount);
+        for (uint32_t y = 0u; y < height; y++)
+        {
+            const CellType* row = cells.Row(y);
+            CellType* low = &rowMin[static_cast<size_t>(y) * width];
+            CellType* high = &rowMax[static_cast<size_t>(y) * width];
+            std::copy_n(row, width, low);
+            std::copy_n(row, width, high);
+            for (uint32_t d = 1u; d <= radius && d < width; d++)
+            {
+                for (uint32_t x = 0u; x + d < width; x++)
+                {
+                    low[x] = std::min(low[x], row[x + d]);
+                    high[x] = std::max(high[x], row[x + d]);
+                }
+                for (uint32_t x = d; x < width; x++)
+                {
+                    low[x] = std::min(low[x], row[x - d]);
+                    high[x] = std::max(high[x], row[x - d]);
+                }
+            }
+        }
+
+        BinaryGrid nearBorder;
+        nearBorder.Resize(width, height);
+        std::vector<CellType> low(width);
+        std::vector<CellType> high(width);
+        for (uint32_t y = 0u; y < height; y++)
+        {
+            uint32_t y0 = y > radius ? y - radius : 0u;
+            uint32_t y1 = std::min(y + radius + 1u, height);
+            std::copy_n(&rowMin[static_cast<size_t>(y0) * width], width, low.data());
+            std::copy_n(&rowMax[static_cast<size_t>(y0) * width], width, high.data());
+            for (uint32_t windowY = y0 + 1u; windowY < y1; windowY++)
+            {
+                const CellType* windowLow = &rowMin[static_cast<size_t>(windowY) * width];
+                const CellType* windowHigh = &rowMax[static_cast<size_t>(windowY) * width];
+                for (uint32_t x = 0u; x < width; x++)
+                {
+                    low[x] = std::min(low[x], windowLow[x]);
+                    high[x] = std::max(high[x], windowHigh[x]);
+                }
+            }
+            uint64_t* bits = nearBorder.Row(y);
+            std::fill_n(bits, nearBorder.GetWordsPerRow(), 0ull);
+            for (uint32_t x = 0u; x < width; x++)
+                bits[x / 64u] |= static_cast<uint64_t>(low[x] != high[x]) << (x % 64u);
+        }
+
+        //The cells scaled from parents near a border are the flippable ones:
+        BinaryGrid flippable;
+        flippable.Scale(nearBorder, multiplier, instructionSet);
+        RefineRandom(multiplier, random, percent, firstType, secondType, &flippable);
+        TrackUniformTiles();
+    }
+
+    void CellularAutomata::InitializeBatch(
+        const std::vector<CellRandom>& randoms, uint32_t percent, uint32_t chosenType, uint32_t otherType)
+    {
+        uint32_t batchCount = std::min(static_cast<uint32_t>(randoms.size()), batchSize);
+        batchCells.Resize(width, height, boundary.haloSize, batchCount);
+        batchOneType = chosenType;
+        batchZeroType = otherType;
+        ForEachBand(height, width * batchCount, 1u, [&](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+            {
+                batchCells.InitializeRandom(randoms, percent, rowBegin, rowEnd, instructionSet);
+            });
+    }
+
+    bool CellularAutomata::RefineBatch(
+        uint32_t multiplier,
+        const std::vector<CellRandom>& randoms, uint32_t percent, uint32_t firstType, uint32_t secondType)
+    {
+        //Every cell of the batch is one of the two types, so a flipped cell always becomes the other one.
+        //That is what RefineRandom does only if its two types are the types of the batch:
+        bool sameTypes = firstType == batchOneType && secondType == batchZeroType;
+        bool swappedTypes = firstType == batchZeroType && secondType == batchOneType;
+        if (!sameTypes && !swappedTypes)
+            return false;
+        nextBatchCells.Scale(batchCells, multiplier);
+        std::swap(batchCells, nextBatchCells);
+        ForEachBand(
+            batchCells.GetHeight(), batchCells.GetWidth() * batchCells.GetSliceCount(), 1u,
+            [&](uint32_t, uint32_t rowBegin, uint32_t rowEnd)
+            {
+                batchCells.FlipRandom(randoms, percent, rowBegin, rowEnd, instructionSet);
+            });
+        return true;
+    }
+
+    bool CellularAutomata::GenerateBatch(uint32_t n)
+    {
+        auto bitRule = GetBitRule();
+        if (!bitRule)
+            return false;
+        const BitRule& r = *bitRule;
+        bool sameTypes = r.countedType == batchOneType && r.otherType == batchZeroType;
+        bool swappedTypes = r.countedType == batchZeroType && r.otherType == batchOneType;
+        if (!sameTypes && !swappedTypes)
+            return false;
+        //The kernels count the set bits, so they must be the counted type:
+        if (swappedTypes)
+        {
+            batchCells.Invert();
+            std::swap(batchOneType, batchZeroType);
+        }
+
+        uint32_t batchWidth = batchCells.GetWidth();
+        uint32_t batchHeight = batchCells.GetHeight();
+        uint32_t batchCount = batchCells.GetSliceCount();
+        uint32_t halo = std::max(batchCells.GetHalo(), r.m);
+        if (halo > batchCells.GetHalo())
+        {
+            //The rows move when the halo changes size, so the cells are copied into a grid with the new halo:
+            nextBatchCells.Resize(batchWidth, batchHeight, halo, batchCount);
+            for (uint32_t y = 0u; y < batchHeight; y++)
+                std::copy_n(batchCells.Row(y), batchWidth, nextBatchCells.Row(y));
+            std::swap(batchCells, nextBatchCells);
+        }
+
+        bitColumnCounts.resize(GetThreadCount());
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            batchCells.UpdateHalo(boundary, boundary.fillType == r.countedType);
+            nextBatchCells.Resize(batchWidth, batchHeight, halo, batchCount);
+            ForEachBand(batchHeight, batchWidth * batchCount, 1u, [&](uint32_t worker, uint32_t rowBegin, uint32_t rowEnd)
+                {
+                    nextBatchCells.Step(
+                        batchCells, r.m,
+                        r.setBits, r.clearedBits,
+                        rowBegin, rowEnd,
+                        bitColumnCounts[worker]);
+                });
+            std::swap(batchCells, nextBatchCells);
+
+            //Once no grid of the batch changes, the remaining steps change nothing either:
+            bool changed = false;
+            for (uint32_t y = 0u; y < batchHeight && !changed; y++)
+                changed = !std::equal(batchCells.Row(y), batchCells.Row(y) + batchWidth, nextBatchCells.Row(y));
+            if (!changed)
+                break;
+        }
+        return true;
+    }
+
+    void CellularAutomata::SelectBatchGrid(uint32_t k)
+    {
+        batchCells.Unpack(k, cells, batchOneType, batchZeroType);
+        width = batchCells.GetWidth();
+        height = batchCells.GetHeight();
+        trackedSteps = 0u;
+        binaryCellsCurrent = false;
+        cells.UpdateHalo(boundary);
+    }
+
+    uint32_t CellularAutomata::GetBatchCount() const
+    {
+        return batchCells.GetSliceCount();
+    }
+
+    void CellularAutomata::SetCells(GridView cells)
+    {
+        width = cells.GetWidth();
+        height = cells.GetHeight();
+        this->cells.Assign(cells);
+        trackedSteps = 0u;
+        binaryCellsCurrent = false;
+        this->cells.UpdateHalo(boundary);
+    }
+
+    void CellularAutomata::Resize(uint32_t width, uint32_t height)
+    {
+        this->width = width;
+        this->height = height;
+        cells.Resize(width, height);
+        trackedSteps = 0u;
+        binaryCellsCurrent = false;
+        cells.UpdateHalo(boundary);
+    }
+
+    void CellularAutomata::Crop(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+    {
+        nextCells.Resize(width, height);
+        for (uint32_t row = 0u; row < height; row++)
+            std::copy_n(cells.Row(y + row) + x, width, nextCells.Row(row));
+        std::swap(cells, nextCells);
+        this->width = width;
+        this->height = height;
+        originX += x;
+        originY += y;
+        trackedSteps = 0u;
+        binaryCellsCurrent = false;
+        cells.UpdateHalo(boundary);
+    }
+
+    void CellularAutomata::SetOrigin(int64_t x, int64_t y)
+    {
+        originX = x;
+        originY = y;
+    }
+
+    int64_t CellularAutomata::GetOriginX() const
+    {
+        return originX;
+    }
+
+    int64_t CellularAutomata::GetOriginY() const
+    {
+        return originY;
     }
 
     void CellularAutomata::Clear()
     {
         width = initWidth;
         height = initHeight;
-        cells.resize(width * height);
-        for (uint32_t y = 0; y < height; y++)
-            for (uint32_t x = 0; x < width; x++)
-                cells[GetIndex(x, y)] = { 0u, x, y };
+        originX = 0;
+        originY = 0;
+        binaryCellsCurrent = false;
+        cells.Resize(width, height);
+        cells.Fill(0u);
+        cells.UpdateHalo(boundary);
+        trackedSteps = 0u;
     }
 
-    const std::vector<CellularAutomata::Cell>& CellularAutomata::GetCells() const
+    CellularAutomata::GridView CellularAutomata::GetCells() const
     {
-        return cells;
+        return cells.GetView();
     }
 
     CellularAutomata::GroupAnalysis CellularAutomata::AnalyzeGroup(
@@ -203,7 +1406,7 @@ namespace pcg
 
         GroupAnalysis analysis{};
         std::stack<Cell> frontier;
-        const Cell& initialCell = GetCell(x, y);
+        Cell initialCell = GetCell(x, y);
         analysis.cellType = initialCell.type;
         frontier.push(initialCell);
         while (!frontier.empty())
@@ -221,9 +1424,11 @@ namespace pcg
             explored[cx + cy * width] = true;
             analysis.positions.push_back({ cx, cy });
             analysis.count++;
-            std::vector<Cell> neighbourhood = VonNeumann(cx, cy, 1u, { initialCell.type });
-            for (const Cell& neighbour : neighbourhood)
-                frontier.push(neighbour);
+            VisitVonNeumann(cx, cy, 1u, initialCell.type,
+                [&frontier, &initialCell](uint32_t nx, uint32_t ny)
+                {
+                    frontier.push({ initialCell.type, nx, ny });
+                });
         }
         return analysis;
     }
@@ -306,7 +1511,7 @@ namespace pcg
             int32_t neighbourX = x - dy;
             int32_t neighbourY = y + dx;
             if (WithinGrid(neighbourX, neighbourY) &&
-                cells[GetIndex(neighbourX, neighbourY)].type == cellType)
+                cells.Get(neighbourX, neighbourY) == cellType)
             {
                 analysis.jaggedness++;
                 x = neighbourX;
@@ -323,7 +1528,7 @@ namespace pcg
             neighbourX = x + dx;
             neighbourY = y + dy;
             if (WithinGrid(neighbourX, neighbourY) &&
-                cells[GetIndex(neighbourX, neighbourY)].type == cellType)
+                cells.Get(neighbourX, neighbourY) == cellType)
             {
                 analysis.length++;
                 x = neighbourX;
@@ -336,7 +1541,7 @@ namespace pcg
             neighbourX = x + dy;
             neighbourY = y - dx;
             if (WithinGrid(neighbourX, neighbourY) &&
-                cells[GetIndex(neighbourX, neighbourY)].type == cellType)
+                cells.Get(neighbourX, neighbourY) == cellType)
             {
                 analysis.jaggedness++;
                 analysis.length++;
@@ -371,7 +1576,7 @@ namespace pcg
             for (size_t x = 0; x < width; x++)
             {
                 int32_t cellType =
-                    static_cast<int32_t>(GetCell(x, y).type);
+                    static_cast<int32_t>(cells.Get(x, y));
                 if (cellType == prevCellType)
                     continue;
                 prevCellType = cellType;
@@ -384,10 +1589,10 @@ namespace pcg
                 int32_t dy = 0;
                 if (
                     y + 1 < height &&
-                    GetCell(x, y + 1).type == cellType)
+                    cells.Get(x, y + 1) == cellType)
                     dy = 1;
                 else if (x + 1 < width &&
-                    GetCell(x + 1, y).type != cellType)
+                    cells.Get(x + 1, y) != cellType)
                     dy = -1;
                 else
                     dx = 1;
@@ -471,7 +1676,7 @@ namespace pcg
         };
         PriorityQueue frontier;
         frontier.push(initial);
-        std::vector<AStarNode> explored(cells.size());
+        std::vector<AStarNode> explored(cells.Size());
         explored[from.x + from.y * width] = initial;
         while (!frontier.empty())
         {
@@ -638,10 +1843,12 @@ namespace pcg
             uint32_t index = xOffset + yOffset * gridSizeX;
             borderDistances[index] = pair.distance;
             explored.insert(pair.position);
-            std::vector<Cell> neighbourhood = VonNeumann(
-                pair.position.x, pair.position.y, 1u, { borderAnalysis.cellType });
-            for (const Cell& neighbour : neighbourhood)
-                frontier.push({ { neighbour.x, neighbour.y }, pair.distance + 1u });
+            VisitVonNeumann(
+                pair.position.x, pair.position.y, 1u, borderAnalysis.cellType,
+                [&frontier, &pair](uint32_t nx, uint32_t ny)
+                {
+                    frontier.push({ { nx, ny }, pair.distance + 1u });
+                });
         }
         return borderDistances;
     }
@@ -790,7 +1997,7 @@ namespace pcg
     {
         uint32_t inAir = 0u;
         for (const auto& position : pathAnalysis.path)
-            if (position.y == 0u || GetCell(position.x, position.y - 1u).type == airCellType)
+            if (position.y == 0u || cells.Get(position.x, position.y - 1u) == airCellType)
                 inAir++;
         return inAir;
     }
@@ -802,8 +2009,8 @@ namespace pcg
         uint32_t onSurface = 0u;
         for (const auto& position : pathAnalysis.path)
             if (position.y != 0u &&
-                GetCell(position.x, position.y).type == airCellType &&
-                GetCell(position.x, position.y - 1u).type != airCellType)
+                cells.Get(position.x, position.y) == airCellType &&
+                cells.Get(position.x, position.y - 1u) != airCellType)
                 onSurface++;
         return onSurface;
     }
@@ -827,11 +2034,11 @@ namespace pcg
                     continue;
                 if (x >= GetWidth())
                     continue;
-                const Cell& bottom = GetCell(x, y - 1u);
-                const Cell& top = GetCell(x, y);
+                uint32_t bottom = cells.Get(x, y - 1u);
+                uint32_t top = cells.Get(x, y);
                 bool isPlatform =
-                    top.type != platformCellType &&
-                    bottom.type == platformCellType;
+                    top != platformCellType &&
+                    bottom == platformCellType;
                 bool buildingPlatform = platformStartIndex != -1;
                 if (isPlatform && !buildingPlatform)
                     platformStartIndex = static_cast<int32_t>(x);
@@ -853,11 +2060,11 @@ namespace pcg
         uint32_t minGapDepth, 
         uint32_t platformCellType) const
     {
-        const Cell* cell = nullptr;
+        uint32_t cell = 0u;
         uint32_t fallen = 0u;
         do
         {
-            cell = &GetCell(position.x, position.y - fallen);
+            cell = cells.Get(position.x, position.y - fallen);
             if (fallen >= minGapDepth)
                 return true;
             fallen++;
@@ -865,7 +2072,7 @@ namespace pcg
                 static_cast<int32_t>(position.y) -
                 static_cast<int32_t>(fallen) < 0)
                 break;
-        } while (cell->type != platformCellType);
+        } while (cell != platformCellType);
         return false;
     }
 
@@ -15,6 +15,18 @@
 #include <vec2.hpp>
 #include <queue>
 #include <unordered_set>
+#include <optional>
+#include "Grid.h"
+#include "SummedAreaTable.h"
+#include "BinaryGrid.h"
+#include "SlicedGrid.h"
+#include "Rules.h"
+#include "ByteKernels.h"
+#include "RuleKernels.h"
+#include "HistogramKernel.h"
+#include "Quadtree.h"
+#include "ThreadPool.h"
+#include "Random.h"
 
 namespace pcg
 {
@@ -25,6 +37,17 @@ namespace pcg
         bool operator==(const Direction& other) const;
     };
 
+    //A set of cell types stored as bits. Only types lower than 32 can be part of a mask, and higher types are left out.
+    struct TypeMask
+    {
+        uint32_t bits = 0u;
+
+        TypeMask() = default;
+        TypeMask(std::initializer_list<uint32_t> cellTypes);
+        [[nodiscard]]
+        bool Contains(uint32_t cellType) const;
+    };
+
     class CellularAutomata
     {
     private:
@@ -32,7 +55,12 @@ namespace pcg
     public:
         using InitFunction = uint32_t(const CellularAutomata&, uint32_t, uint32_t);
         using RuleFunction = uint32_t(const CellularAutomata&, uint32_t, uint32_t);
+        //Gives the type of the cell (x, y) of the refined grid from the type of its parent cell.
+        using RefineFunction = uint32_t(const CellularAutomata&, uint32_t, uint32_t, uint32_t);
         using CostFunction = uint32_t(const CellularAutomata& ca, const AStarNode& from, const glm::uvec2& to);
+        using CellType = uint8_t;
+        using Grid = BasicGrid<CellType>;
+        using GridView = BasicGridView<CellType>;
 
         struct Cell
         {
@@ -41,6 +69,37 @@ namespace pcg
             uint32_t y;
         };
 
+        enum class CountingMode
+        {
+            //Count the neighbourhood cell by cell. Cost grows with the square of the radius.
+            Direct,
+            //Build a summed-area table per counted type each step. Every count costs four lookups.
+            SummedAreaTable
+        };
+
+        //The engine used for stepping declarative rules. Rules given as functions always use the rule function.
+        enum class Engine
+        {
+            //Use the fastest engine which supports the rule and the current grid.
+            Automatic,
+            //Call the rule function for every cell.
+            Function,
+            //Count with SIMD on one byte per cell. Supports Moore neighbourhoods up to maxByteKernelRadius.
+            //The rule of every type must be an interval of counts, and at most ByteRule::maxTransitions types can have their own rule.
+            Bytes,
+            //Count with bit operations on one bit per cell. Requires a Moore neighbourhood and a grid containing only the counted type
+            //and the type it turns into, whose rules must be intervals of counts.
+            Bits,
+            //Count with kernels compiled for every radius up to maxCompiledRadius. Supports every neighbourhood.
+            Compiled,
+            //Count every type of a HistogramRule with sliding windows. Supports radii up to the halo size.
+            Histogram,
+            //Advance a hash-consed quadtree of the grid, memoizing the result of every block. Supports every neighbourhood and radius,
+            //but only BoundaryPolicy::Fill. Only pays off on grids with many repeated or stable blocks and many generations,
+            //so it is never picked automatically.
+            Quadtree
+        };
+
         struct GroupAnalysis
         {
             int32_t count = 0;
@@ -79,21 +138,88 @@ namespace pcg
             std::vector<PathAnalysis> pathAnalyses;
         };
     private:
-        std::vector<Cell> cells;
+        //Both grids carry the halo described by the boundary, which is kept up to date after every change.
+        Grid cells;
+        Grid nextCells;
+        Boundary boundary;
         uint32_t initWidth;
         uint32_t initHeight;
         uint32_t width;
         uint32_t height;
+        //Coordinates of the first cell in a grid without edges, which the random initialization and refinement are keyed by.
+        int64_t originX = 0;
+        int64_t originY = 0;
         std::function<InitFunction> initializer;
         std::function<RuleFunction> rule;
+        //The rule as given to SetRule, if it was declarative. It is compiled into the table and the byte rule.
+        std::optional<OuterTotalisticRule> declarativeRule;
+        RuleTable ruleTable;
+        std::optional<ByteRule> byteRule;
+        std::optional<HistogramRule> histogramRule;
+        std::vector<std::vector<HistogramRule::Counts>> histogramColumnCounts;
+        BinaryGrid binaryCells;
+        BinaryGrid nextBinaryCells;
+        //True while binaryCells holds the cells packed with binaryOneType as set bits, which is from a step on the bit engine
+        //until the cells are changed in another way. Scale then scales the packed cells, and the bit engine skips packing.
+        bool binaryCellsCurrent = false;
+        uint32_t binaryOneType = 0u;
+        uint32_t binaryZeroType = 0u;
         std::function<CostFunction> costFunction;
+        CountingMode countingMode = CountingMode::Direct;
+        TypeMask countedTypes;
+        std::vector<SummedAreaTable> tables;
+        bool tablesBuilt = false;
+        Engine engine = Engine::Automatic;
+        InstructionSet instructionSet = supportedInstructionSet();
+        //Two tile buffers of this size with their halos fit in a 1 MiB L2 cache.
+        //Smaller tiles spend too much time on the halos and on the scalar ends of the rows.
+        static constexpr uint32_t defaultTemporalTileSize = 512u;
+        //Without a thread pool every step runs on the calling thread.
+        std::shared_ptr<ThreadPool> threadPool;
+        //Scratch memory of the stepping kernels, one per worker of the thread pool.
+        std::vector<std::vector<uint8_t>> byteColumnCounts;
+        std::vector<std::vector<uint64_t>> bitColumnCounts;
+        //Tiles are advanced in these buffers, one pair per worker, when temporal blocking is used.
+        std::vector<std::pair<Grid, Grid>> tileBuffers;
+        uint32_t temporalTileSize = defaultTemporalTileSize;
+        //Tiles of this size are small enough to skip most of a grid which is nearly stable,
+        //and large enough that checking them costs little compared to stepping them.
+        static constexpr uint32_t defaultActivityTileSize = 64u;
+        uint32_t activityTileSize = defaultActivityTileSize;
+        //While tracking, nextCells holds the previous generation and olderCells the one before it.
+        Grid olderCells;
+        //Bit flags telling how every tile changed in the last tracked step.
+        std::vector<uint8_t> tileChanges;
+        std::vector<uint8_t> nextTileChanges;
+        std::vector<uint8_t> activeTiles;
+        //Tracked steps since the grid was last changed in another way. The flags are only valid after one tracked step.
+        uint32_t trackedSteps = 0u;
+        uint32_t stepsPerformed = 0u;
+        //Kept between calls to Generate, so blocks seen before are not advanced again. Reset when the rule or boundary changes.
+        Quadtree quadtree;
+        bool quadtreeReset = false;
+        //A batch of grids of the size batchCells holds, stepped together with the bit transitions of the rule.
+        SlicedGrid batchCells;
+        SlicedGrid nextBatchCells;
+        uint32_t batchOneType = 0u;
+        uint32_t batchZeroType = 0u;
 
-        [[nodiscard]]
-        uint32_t GetIndex(uint32_t x, uint32_t y) const;
-        [[nodiscard]]
-        std::vector<Cell> Scale(
-            const std::vector<Cell>& cells,
-            uint32_t width, uint32_t height, uint32_t multiplier) const;
+        //A declarative rule as transitions of bits, where the set bits are the counted type.
+        struct BitRule
+        {
+            uint32_t m;
+            uint32_t countedType;
+            uint32_t otherType;
+            BitTransition setBits;
+            BitTransition clearedBits;
+        };
+
+        void Scale(const Grid& cells, Grid& scaledCells, uint32_t multiplier) const;
+        //Does the work of RefineRandom, but only cells with a set bit in flippable are flipped if it is given.
+        void RefineRandom(
+            uint32_t multiplier,
+            const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType,
+            const BinaryGrid* flippable);
 
         //Private analysis functions:
         [[nodiscard]]
@@ -109,6 +235,46 @@ namespace pcg
             uint32_t startX, uint32_t startY,
             int32_t startDx, int32_t startDy) const;
         bool WithinGrid(int32_t x, int32_t y) const;
+        //Splits the rows into bands of at least minRows rows and calls stepRows for each of them on the thread pool.
+        void ForEachBand(uint32_t minRows, const std::function<ThreadPool::RangeFunction>& stepRows);
+        //Splits the rows [0, rowCount) of a grid rowWidth cells wide into bands.
+        void ForEachBand(
+            uint32_t rowCount, uint32_t rowWidth, uint32_t minRows,
+            const std::function<ThreadPool::RangeFunction>& stepRows);
+        void StepFunction();
+        [[nodiscard]]
+        bool StepThreshold(uint32_t n);
+        //Empty unless the rule has a Moore neighbourhood and only turns the counted type and one other type into each other.
+        [[nodiscard]]
+        std::optional<BitRule> GetBitRule() const;
+        [[nodiscard]]
+        bool StepBinary(uint32_t n);
+        [[nodiscard]]
+        bool StepBytes(uint32_t n);
+        [[nodiscard]]
+        bool StepCompiled(uint32_t n);
+        [[nodiscard]]
+        bool StepQuadtree(uint32_t n);
+        [[nodiscard]]
+        bool StepHistogram(uint32_t n);
+        void StepBytesTiled(const ByteRule& rule, uint32_t n);
+        //Steps only the tiles whose neighbourhood changed in the last step and records which tiles change.
+        //Returns false if the rule is not declarative or no engine supporting tiles can step it.
+        [[nodiscard]]
+        bool StepTracked();
+        //Starts tracking as if the last step changed only the tiles which are not uniform within the reach of the rule,
+        //so the next tracked step skips the others. Only done if the rule keeps every uniform neighbourhood as it is.
+        void TrackUniformTiles();
+        enum class Convergence
+        {
+            None,
+            FixedPoint,
+            //The grid alternates between two generations.
+            Cycle
+        };
+
+        [[nodiscard]]
+        Convergence GetConvergence() const;
 
         struct AStarNode
         {
@@ -164,14 +330,45 @@ namespace pcg
     public:
         CellularAutomata(uint32_t width, uint32_t height);
 
+        //The initializer is called from several threads at once, unless the thread count is set to 1.
+        //It may read the cell it initializes, but no other cell. CellRandom in Random.h gives random values which allow this.
         void SetInitializer(std::function<InitFunction> initializer);
         void SetRule(std::function<RuleFunction> rule);
+        //Declarative rules are compiled into a RuleTable and stepped with one of the specialized engines. See Engine.
+        void SetRule(const ThresholdRule& rule);
+        void SetRule(const OuterTotalisticRule& rule);
+        //Rules given the counts of several types. These are stepped with the histogram kernel, see Engine::Histogram.
+        void SetRule(const HistogramRule& rule);
         void SetCostFunction(std::function<CostFunction> costFunction);
+        void SetCountingMode(CountingMode countingMode, TypeMask countedTypes = {});
+        void SetEngine(Engine engine);
+        //Limits the SIMD kernels to the given instruction set. Instruction sets not supported by the processor are ignored.
+        void SetInstructionSet(InstructionSet instructionSet);
+        //Steps are split into bands of rows which run in parallel. A rule function must then be safe to call from several threads.
+        //A thread count of 1 runs every step on the calling thread.
+        void SetThreadCount(uint32_t threadCount);
+        void SetThreadPool(std::shared_ptr<ThreadPool> threadPool);
+        //Generate(n) with a declarative rule on the byte engine splits the grid into tiles of tileSize * tileSize cells.
+        //Every tile is advanced all n generations at once together with a halo of n * m cells, while it is in cache.
+        //The result is the same as stepping the whole grid n times. A tile size of 0 disables the tiling.
+        void SetTemporalBlocking(uint32_t tileSize);
+        //Declarative rules step the grid in tiles of tileSize * tileSize cells, and tiles whose neighbourhood did not change
+        //in the last step are skipped. Generate then stops once the grid reaches a fixed point or a cycle of two generations,
+        //with the same result as running every step. Temporal blocking is only used when this is disabled by a tile size of 0.
+        void SetActivityTracking(uint32_t tileSize);
+        [[nodiscard]]
+        uint32_t GetThreadCount() const;
+        //Decides what the neighbours outside the grid are. By default they are voidType, which no rule counts.
+        //Neighbourhoods up to the halo size are counted without checking the edges of the grid.
+        void SetBoundary(const Boundary& boundary);
+        [[nodiscard]]
+        const Boundary& GetBoundary() const;
         void SetCell(uint32_t type, uint32_t x, uint32_t y);
         [[nodiscard]]
-        const Cell& GetCell(uint32_t x, uint32_t y) const;
+        Cell GetCell(uint32_t x, uint32_t y) const;
         uint32_t GetWidth() const;
         uint32_t GetHeight() const;
+        //Cells outside the grid are returned at the position they read from. Under BoundaryPolicy::Fill they are left out.
         [[nodiscard]]
         std::vector<Cell> Moore(
             uint32_t x, 
@@ -182,13 +379,92 @@ namespace pcg
             uint32_t x, uint32_t y, 
             uint32_t m, 
             const std::vector<uint32_t>& cellTypes) const;
+
+        //Allocation free neighbourhood queries. These count the matching cells instead of returning them.
+        //Cells outside the grid are counted following the boundary.
+        [[nodiscard]]
+        uint32_t MooreCount(uint32_t x, uint32_t y, uint32_t m, uint32_t cellType) const;
+        [[nodiscard]]
+        uint32_t MooreCount(uint32_t x, uint32_t y, uint32_t m, TypeMask cellTypes) const;
+        [[nodiscard]]
+        uint32_t VonNeumannCount(uint32_t x, uint32_t y, uint32_t r, uint32_t cellType) const;
+        [[nodiscard]]
+        uint32_t VonNeumannCount(uint32_t x, uint32_t y, uint32_t r, TypeMask cellTypes) const;
+        //Only visits cells within the grid, as the analysis functions follow the shapes of the map.
+        template<typename Visitor>
+        void VisitVonNeumann(
+            uint32_t x, uint32_t y,
+            uint32_t r,
+            uint32_t cellType,
+            Visitor&& visit) const;
         void Step();
         void Generate(uint32_t n);
+        //Number of steps computed by the last call to Generate. Less than n if it stopped early.
+        [[nodiscard]]
+        uint32_t GetStepsPerformed() const;
         void Initialize();
         void Scale(uint32_t multiplier);
+        //Does the work of Scale followed by Initialize in one pass. Every cell of the scaled grid is set to
+        //refine(ca, parentType, x, y), where parentType is the type of the cell it was scaled from.
+        //The automata still holds the parent grid while refine is called, so GetCell must be called with parent coordinates.
+        //Like the initializer, refine is called from several threads at once unless the thread count is set to 1.
+        void Refine(uint32_t multiplier, const std::function<RefineFunction>& refine);
+        //Sets every cell to chosenType if random.Percent(x, y, percent) holds, and to otherType otherwise.
+        //The coordinates are offset by the origin, see SetOrigin.
+        //The result is the same as Initialize with such an initializer, but the random values are computed
+        //many cells at once with SIMD, and the cells are packed for the bit engine as well.
+        void InitializeRandom(const CellRandom& random, uint32_t percent, uint32_t chosenType, uint32_t otherType);
+        //Scales the grid and flips the cells for which random.Percent(x, y, percent) holds, in scaled coordinates offset by the scaled origin.
+        //A flipped cell of firstType becomes secondType, and any other flipped cell becomes firstType.
+        //If the cells are packed from a step on the bit engine, the packed cells are scaled and flipped instead.
+        void RefineRandom(uint32_t multiplier, const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType);
+        //Like RefineRandom, but only cells scaled from a parent within radius parent cells of a parent of another type
+        //are flipped, and they are flipped exactly as by RefineRandom. Blocks away from the borders stay uniform.
+        //Flips only near borders and skips uniform tiles on the first tracked step, but the whole grid is still
+        //scaled, written and scanned for uniform tiles. It pays off at large multipliers, like 8, where most tiles are
+        //uniform, and it is slower than RefineRandom at a multiplier of 3, where nearly every tile touches a border.
+        void RefineBorders(
+            uint32_t multiplier,
+            const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType,
+            uint32_t radius);
+        //Batches hold up to batchSize grids of two cell types, bitsliced so every step works on all of them at once.
+        //A batch has the size of the grid when initialized. The grid of the automata is only changed by SelectBatchGrid.
+        static constexpr uint32_t batchSize = SlicedGrid::maxSliceCount;
+        //Starts a batch with a grid per generator, where grid k is initialized like InitializeRandom with randoms[k].
+        void InitializeBatch(
+            const std::vector<CellRandom>& randoms, uint32_t percent, uint32_t chosenType, uint32_t otherType);
+        //Scales every grid of the batch and flips its cells like RefineRandom with randoms[k].
+        //Returns false, without changing the batch, unless the two types are the types of the batch in either order.
+        [[nodiscard]]
+        bool RefineBatch(
+            uint32_t multiplier,
+            const std::vector<CellRandom>& randoms, uint32_t percent, uint32_t firstType, uint32_t secondType);
+        //Steps every grid of the batch n times. Returns false, without stepping, unless the rule is declarative
+        //and only turns the two types of the batch into each other within a Moore neighbourhood.
+        [[nodiscard]]
+        bool GenerateBatch(uint32_t n);
+        //Makes grid k of the batch the grid of the automata, so it can be analysed.
+        void SelectBatchGrid(uint32_t k);
+        [[nodiscard]]
+        uint32_t GetBatchCount() const;
+        //Replaces the grid with a copy of the cells, which may have another size.
+        void SetCells(GridView cells);
+        //Changes the size of the grid. The cells are undefined until they are initialized.
+        void Resize(uint32_t width, uint32_t height);
+        //Keeps only the given rectangle of the grid and moves the origin to its first cell.
+        void Crop(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+        //The grid is a window of a grid without edges, whose first cell has the given coordinates.
+        //InitializeRandom and RefineRandom give a cell the random values of these coordinates, which wrap around at 2^32,
+        //so windows of the same grid match where they overlap. Scaling multiplies the origin by the multiplier.
+        void SetOrigin(int64_t x, int64_t y);
+        [[nodiscard]]
+        int64_t GetOriginX() const;
+        [[nodiscard]]
+        int64_t GetOriginY() const;
+        //Returns to the initial size, with every cell 0 and the origin at zero.
         void Clear();
         [[nodiscard]]
-        const std::vector<Cell>& GetCells() const;
+        GridView GetCells() const;
 
         //Public analysis functions:
         [[nodiscard]]
@@ -242,6 +518,32 @@ namespace pcg
     [[nodiscard]]
     std::vector<uint32_t> straightLines(
         const std::vector<Direction>& directions);
+
+    template<typename Visitor>
+    inline void CellularAutomata::VisitVonNeumann(
+        uint32_t x, uint32_t y,
+        uint32_t r,
+        uint32_t cellType,
+        Visitor&& visit) const
+    {
+        int32_t sx = static_cast<int32_t>(x);
+        int32_t sy = static_cast<int32_t>(y);
+        int32_t sr = static_cast<int32_t>(r);
+
+        for (int32_t y0 = -sr; y0 <= sr; y0++)
+        {
+            int32_t y1 = sy + y0;
+            if (y1 < 0 || y1 >= static_cast<int32_t>(height))
+                continue;
+            int32_t d = std::abs(y0) - sr;
+            int32_t x0 = std::max(sx + d, 0);
+            int32_t x1 = std::min(sx - d, static_cast<int32_t>(width) - 1);
+            const CellType* row = cells.Row(y1);
+            for (; x0 <= x1; x0++)
+                if (row[x0] == cellType)
+                    visit(static_cast<uint32_t>(x0), static_cast<uint32_t>(y1));
+        }
+    }
 }
 
 #endif
@@ -13,30 +13,45 @@ namespace pcg
         options.n = 4;
         options.m = 4;
         options.t = 40;*/
-        ca.SetInitializer(
-            [this](const CellularAutomata& ca, uint32_t x, uint32_t y)
-            {
-                static Random<uint32_t> random(1u, 100u);
-                return random.Get() <= options.r;
-            });
+    }
 
-        ca.SetRule(
-            [this](const CellularAutomata& ca, uint32_t x, uint32_t y)
+    void CaveGenerator::SetUpAutomata()
+    {
+        ca.Clear();
+        ca.SetRule(ThresholdRule
             {
-                uint32_t neighbourhood = ca.Moore(x, y, options.m, { rock }).size();
-                if (neighbourhood >= options.t)
-                    return rock;
-                return floor;
+                .m = options.m,
+                .t = options.t,
+                .countedType = rock,
+                .typeAtThreshold = rock,
+                .typeBelowThreshold = floor
             });
+        //Summed-area tables make the count independent of the radius. For m = 1 counting directly is as fast.
+        ca.SetCountingMode(
+            options.m > 1u ?
+            CellularAutomata::CountingMode::SummedAreaTable :
+            CellularAutomata::CountingMode::Direct,
+            { rock });
     }
 
-    void CaveGenerator::Generate()
+    void CaveGenerator::Generate(uint64_t seed)
     {
-        ca.Clear();
-        ca.Initialize();
+        this->seed = seed;
+        SetUpAutomata();
+        ca.InitializeRandom(CellRandom(seed, 0u), options.r, rock, floor);
         ca.Generate(options.n);
     }
 
+    bool CaveGenerator::GenerateSliced(const std::vector<uint64_t>& seeds)
+    {
+        SetUpAutomata();
+        std::vector<CellRandom> randoms;
+        for (uint64_t seed : seeds)
+            randoms.emplace_back(seed, 0u);
+        ca.InitializeBatch(randoms, options.r, rock, floor);
+        return ca.GenerateBatch(options.n);
+    }
+
     std::vector<glm::vec3> CaveGenerator::GetCellColors() const
     {
         return
@@ -1,7 +1,8 @@
 /*
 * An implementation of the cellular automata for cave generator by Lawrence Johnson, Georgios N. Yannakis, and Julian Togelius.
 * The implementation is described inn their paper "Cellular automata for real-time generation of infinite cave levels".
-* Note that this implementation does not allow for infinite generation of caves.
+* Note that this implementation does not allow for infinite generation of caves. CaveWorld generates caves without edges
+* as chunks of a CaveLodGenerator.
 */
 
 #ifndef PCG_CAVEGENERATOR_H
@@ -25,9 +26,15 @@ namespace pcg
         };
     private:
         Options options;
+
+        void SetUpAutomata();
+    protected:
+        [[nodiscard]]
+        bool GenerateSliced(const std::vector<uint64_t>& seeds) override;
     public:
         CaveGenerator(uint32_t width, uint32_t height);
-        void Generate() override;
+        using Generator::Generate;
+        void Generate(uint64_t seed) override;
         [[nodiscard]]
         std::vector<glm::vec3> GetCellColors() const override;
         void SetOptions(const Options& options);
@@ -1,5 +1,6 @@
 #include "CaveLodGenerator.h"
 #include "Random.h"
+#include "pcg/TiledAutomata.h"
 #include <iostream>
 
 namespace pcg
@@ -14,11 +15,6 @@ namespace pcg
                 .n = 4,
                 .t = 40,
                 .m = 4,*/
-                .initializer = [](const Options& o, const CellularAutomata& ca, uint32_t x, uint32_t y)
-                {
-                    static Random<uint32_t> random(1u, 100u);
-                    return random.Get() <= o.r ? rock : floor;
-                }
             },
             {
                 /*.r = 85u,
@@ -45,19 +41,9 @@ namespace pcg
                 .n = 2u,
                 .t = 6u,
                 .m = 1u,
-
-                .initializer = [](const Options& o, const CellularAutomata& ca, uint32_t x, uint32_t y)
-                {
-                    static Random<uint32_t> random(1u, 100u);
-                    uint32_t cell = ca.GetCell(x, y).type;
-                    /*if (cell == rock)
-                        return random.Get() <= o.r ? rock : floor;
-                    return floor;*/
-
-                    if (random.Get() <= o.r)
-                        return cell == rock ? floor : rock;
-                    return cell;
-                }
+                .initializer = nullptr,
+                .refiner = nullptr,
+                .rule = nullptr
             }/*,
             {
                 /*.r = 85u,
@@ -102,30 +88,305 @@ namespace pcg
         this->options = options;
     }
 
-    void CaveLodGenerator::Generate()
+    void CaveLodGenerator::SetUpLayer(const Options& o)
     {
-        ca.Clear();
+        if (o.rule)
+            ca.SetRule(
+                [&o](const CellularAutomata& ca, uint32_t x, uint32_t y)
+                {
+                    return o.rule(o, ca, x, y);
+                });
+        else
+            ca.SetRule(ThresholdRule
+                {
+                    .m = o.m,
+                    .t = o.t,
+                    .countedType = rock,
+                    .typeAtThreshold = rock,
+                    .typeBelowThreshold = floor
+                });
 
-        for (size_t i = 0; i < options.size(); i++)
+        ca.SetCountingMode(
+            o.m > 1u ?
+            CellularAutomata::CountingMode::SummedAreaTable :
+            CellularAutomata::CountingMode::Direct,
+            { rock });
+    }
+
+    void CaveLodGenerator::Generate(uint64_t seed)
+    {
+        this->seed = seed;
+        levelSeeds.assign(options.size(), seed);
+        levels.clear();
+        RegenerateFrom(0u);
+    }
+
+    void CaveLodGenerator::RestoreLevels(uint32_t levelCount)
+    {
+        //Levels without a seed, like after a batch, use the seed of the current map:
+        levelSeeds.resize(options.size(), seed);
+        levels.resize(levelCount);
+        if (levelCount == 0u)
+            ca.Clear();
+        else
+            ca.SetCells(levels.back().GetView());
+    }
+
+    //The steps of a level carry a border at most n * m cells, which is this many parent cells:
+    static uint32_t borderRadius(const CaveLodGenerator::Options& o, uint32_t multiplier)
+    {
+        return std::max((o.n * o.m + multiplier - 1u) / multiplier, 1u);
+    }
+
+    void CaveLodGenerator::InitializeLevel(uint32_t level)
+    {
+        const auto& o = options[level];
+        CellRandom random(levelSeeds[level], level);
+        SetUpLayer(o);
+
+        if (level > 0u && o.refiner)
+            ca.Refine(
+                options[level - 1u].multiplier,
+                [&o, random](const CellularAutomata& ca, uint32_t parentType, uint32_t x, uint32_t y)
+                {
+                    return o.refiner(o, ca, random, parentType, x, y);
+                });
+        else if (o.initializer)
         {
-            const auto& o = options[i];
+            if (level > 0u)
+                ca.Scale(options[level - 1u].multiplier);
             ca.SetInitializer(
-                [&o](const CellularAutomata& ca, uint32_t x, uint32_t y)
+                [&o, random](const CellularAutomata& ca, uint32_t x, uint32_t y)
                 {
-                    return o.initializer(o, ca, x, y);
+                    return o.initializer(o, ca, random, x, y);
                 });
+            ca.Initialize();
+        }
+        else if (level > 0u && o.sparse)
+        {
+            uint32_t multiplier = options[level - 1u].multiplier;
+            ca.RefineBorders(multiplier, random, o.r, rock, floor, borderRadius(o, multiplier));
+        }
+        else if (level > 0u)
+            ca.RefineRandom(options[level - 1u].multiplier, random, o.r, rock, floor);
+        else
+            ca.InitializeRandom(random, o.r, rock, floor);
+    }
 
-            ca.SetRule(
-                [&o](const CellularAutomata& ca, uint32_t x, uint32_t y)
+    void CaveLodGenerator::GenerateLevel(uint32_t level)
+    {
+        InitializeLevel(level);
+        ca.Generate(options[level].n);
+        levels.emplace_back().Assign(ca.GetCells());
+    }
+
+    //Floor and ceiling of a division by a positive divisor, also for negative numerators:
+    static int64_t floorDivide(int64_t numerator, int64_t divisor)
+    {
+        int64_t quotient = numerator / divisor;
+        return quotient * divisor > numerator ? quotient - 1 : quotient;
+    }
+
+    static int64_t ceilDivide(int64_t numerator, int64_t divisor)
+    {
+        return -floorDivide(-numerator, divisor);
+    }
+
+    void CaveLodGenerator::GenerateCone(uint64_t seed, int64_t x, int64_t y, uint32_t width, uint32_t height, bool bounded)
+    {
+        this->seed = seed;
+        levelSeeds.assign(options.size(), seed);
+        levels.clear();
+
+        struct Window
+        {
+            int64_t x0, y0, x1, y1;
+
+            [[nodiscard]]
+            Window Grown(int64_t margin) const
+            {
+                return { x0 - margin, y0 - margin, x1 + margin, y1 + margin };
+            }
+            [[nodiscard]]
+            Window Clipped(const Window& bounds) const
+            {
+                return { std::max(x0, bounds.x0), std::max(y0, bounds.y0), std::min(x1, bounds.x1), std::min(y1, bounds.y1) };
+            }
+        };
+        uint32_t levelCount = static_cast<uint32_t>(options.size());
+        std::vector<Window> maps(levelCount, { 0, 0, initWidth, initHeight });
+        for (uint32_t level = 1u; level < levelCount; level++)
+        {
+            int64_t multiplier = options[level - 1u].multiplier;
+            maps[level] = { 0, 0, maps[level - 1u].x1 * multiplier, maps[level - 1u].y1 * multiplier };
+        }
+        auto clip = [&](const Window& window, uint32_t level)
+        {
+            return bounded ? window.Clipped(maps[level]) : window;
+        };
+
+        //Going down from the last level, the cells every level must be exact in after its steps, and the cells its steps start from.
+        //The steps are exact n * m cells within the cells they start from on every side, and those are scaled
+        //from the parent cells covering them. Refining near borders only also reads the parents within the radius.
+        //On a bounded map the cells are clipped to the map, where the edges of the automata are the edges of the map.
+        std::vector<Window> windows(levelCount);
+        std::vector<Window> starts(levelCount);
+        windows.back() = clip({ x, y, x + width, y + height }, levelCount - 1u);
+        for (uint32_t level = levelCount; level-- > 0u;)
+        {
+            const auto& o = options[level];
+            starts[level] = clip(windows[level].Grown(static_cast<int64_t>(o.n) * o.m), level);
+            if (level == 0u)
+                break;
+            uint32_t multiplier = options[level - 1u].multiplier;
+            int64_t parentMargin = o.sparse && !o.refiner && !o.initializer ? borderRadius(o, multiplier) : 0;
+            const Window& start = starts[level];
+            windows[level - 1u] = clip(
                 {
-                    return o.rule(o, ca, x, y);
-                });
+                    floorDivide(start.x0, multiplier) - parentMargin,
+                    floorDivide(start.y0, multiplier) - parentMargin,
+                    ceilDivide(start.x1, multiplier) + parentMargin,
+                    ceilDivide(start.y1, multiplier) + parentMargin
+                },
+                level - 1u);
+        }
 
-            ca.Initialize();
-            ca.Generate(o.n);
-            if (i < options.size() - 1ull)
-                ca.Scale(o.multiplier);
+        //Every level is stepped from its start and cut down to its window after the steps:
+        for (uint32_t level = 0u; level < levelCount; level++)
+        {
+            const Window& window = windows[level];
+            const Window& start = starts[level];
+            uint32_t startWidth = static_cast<uint32_t>(start.x1 - start.x0);
+            uint32_t startHeight = static_cast<uint32_t>(start.y1 - start.y0);
+            if (level == 0u)
+            {
+                ca.Resize(startWidth, startHeight);
+                ca.SetOrigin(start.x0, start.y0);
+                InitializeLevel(level);
+            }
+            else
+            {
+                InitializeLevel(level);
+                ca.Crop(
+                    static_cast<uint32_t>(start.x0 - ca.GetOriginX()),
+                    static_cast<uint32_t>(start.y0 - ca.GetOriginY()),
+                    startWidth, startHeight);
+            }
+            ca.Generate(options[level].n);
+            ca.Crop(
+                static_cast<uint32_t>(window.x0 - start.x0), static_cast<uint32_t>(window.y0 - start.y0),
+                static_cast<uint32_t>(window.x1 - window.x0), static_cast<uint32_t>(window.y1 - window.y0));
+        }
+    }
+
+    void CaveLodGenerator::GenerateWindow(uint64_t seed, int64_t x, int64_t y, uint32_t width, uint32_t height)
+    {
+        GenerateCone(seed, x, y, width, height, false);
+    }
+
+    void CaveLodGenerator::GenerateRegion(uint64_t seed, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+    {
+        uint64_t mapWidth = initWidth;
+        uint64_t mapHeight = initHeight;
+        for (size_t level = 0ull; level + 1ull < options.size(); level++)
+        {
+            mapWidth *= options[level].multiplier;
+            mapHeight *= options[level].multiplier;
         }
+        x = static_cast<uint32_t>(std::min<uint64_t>(x, mapWidth));
+        y = static_cast<uint32_t>(std::min<uint64_t>(y, mapHeight));
+        width = static_cast<uint32_t>(std::min<uint64_t>(width, mapWidth - x));
+        height = static_cast<uint32_t>(std::min<uint64_t>(height, mapHeight - y));
+
+        //Given initializers and refiners get the coordinates within the cells generated, and a wrapping map
+        //reads cells from the opposite edge, so in these cases the whole map is generated and cut:
+        bool custom = std::any_of(
+            options.begin(), options.end(),
+            [](const Options& o) { return o.initializer || o.refiner; });
+        if (custom || ca.GetBoundary().policy == BoundaryPolicy::Wrap)
+        {
+            Generate(seed);
+            ca.Crop(x, y, width, height);
+            levels.clear();
+            return;
+        }
+        GenerateCone(seed, x, y, width, height, true);
+    }
+
+    void CaveLodGenerator::RegenerateFrom(uint32_t level)
+    {
+        level = std::min(level, static_cast<uint32_t>(std::min(levels.size(), options.size())));
+        RestoreLevels(level);
+        for (uint32_t i = level; i < options.size(); i++)
+            GenerateLevel(i);
+    }
+
+    void CaveLodGenerator::RegenerateLevel(uint32_t level, uint64_t seed)
+    {
+        //Missing levels below are generated first, with their own seeds:
+        uint32_t begin = std::min(level, static_cast<uint32_t>(levels.size()));
+        RestoreLevels(begin);
+        levelSeeds[level] = seed;
+        if (level == 0u)
+            this->seed = seed;
+        for (uint32_t i = begin; i <= level; i++)
+            GenerateLevel(i);
+    }
+
+    void CaveLodGenerator::RegenerateFrom(uint32_t level, uint64_t seed)
+    {
+        levelSeeds.resize(options.size(), this->seed);
+        for (size_t i = level; i < levelSeeds.size(); i++)
+            levelSeeds[i] = seed;
+        RegenerateFrom(level);
+    }
+
+    uint32_t CaveLodGenerator::GetLevelCount() const
+    {
+        return static_cast<uint32_t>(levels.size());
+    }
+
+    CellularAutomata::GridView CaveLodGenerator::GetLevel(uint32_t level) const
+    {
+        return levels[level].GetView();
+    }
+
+    uint64_t CaveLodGenerator::GetLevelSeed(uint32_t level) const
+    {
+        return levelSeeds[level];
+    }
+
+    bool CaveLodGenerator::GenerateSliced(const std::vector<uint64_t>& seeds)
+    {
+        //Only the default initialization, refinement and rule can be stepped bitsliced:
+        for (const auto& o : options)
+            if (o.initializer || o.refiner || o.rule || o.sparse)
+                return false;
+
+        //The levels of a batch are not kept, so regenerating a map of the batch starts from the first level.
+        levels.clear();
+        levelSeeds.clear();
+        ca.Clear();
+        std::vector<CellRandom> randoms;
+        for (size_t i = 0; i < options.size(); i++)
+        {
+            const auto& o = options[i];
+            randoms.clear();
+            for (uint64_t seed : seeds)
+                randoms.emplace_back(seed, static_cast<uint32_t>(i));
+            SetUpLayer(o);
+
+            if (i > 0ull)
+            {
+                if (!ca.RefineBatch(options[i - 1ull].multiplier, randoms, o.r, rock, floor))
+                    return false;
+            }
+            else
+                ca.InitializeBatch(randoms, o.r, rock, floor);
+            if (!ca.GenerateBatch(o.n))
+                return false;
+        }
+        return true;
     }
 
     std::vector<glm::vec3> CaveLodGenerator::GetCellColors() const
@@ -139,10 +400,47 @@ namespace pcg
 
     void CaveLodGenerator::SetOptions(Options options, uint32_t index)
     {
-        if (options.initializer == nullptr)
+        if (options.initializer == nullptr && options.refiner == nullptr)
+        {
             options.initializer = this->options[index].initializer;
+            options.refiner = this->options[index].refiner;
+        }
         if (options.rule == nullptr)
             options.rule = this->options[index].rule;
         this->options[index] = options;
     }
+
+    bool CaveLodGenerator::GenerateTiled(uint64_t seed, TiledGrid& result, TiledGrid& scratch)
+    {
+        this->seed = seed;
+        levelSeeds.assign(options.size(), seed);
+        levels.clear();
+        for (size_t level = 1ull; level < options.size(); level++)
+            if (options[level].initializer || options[level].refiner)
+                return false;
+
+        ca.Clear();
+        InitializeLevel(0u);
+        ca.Generate(options[0].n);
+        if (!result.Resize(ca.GetWidth(), ca.GetHeight()))
+            return false;
+        result.Write(0u, 0u, ca.GetCells());
+
+        //Every level is refined from result into scratch, and stepped from scratch back into result:
+        TiledAutomata tiled(ca);
+        for (uint32_t level = 1u; level < options.size(); level++)
+        {
+            const auto& o = options[level];
+            CellRandom random(levelSeeds[level], level);
+            uint32_t multiplier = options[level - 1u].multiplier;
+            SetUpLayer(o);
+            bool refined = o.sparse ?
+                tiled.RefineBorders(result, scratch, multiplier, random, o.r, rock, floor, borderRadius(o, multiplier)) :
+                tiled.RefineRandom(result, scratch, multiplier, random, o.r, rock, floor);
+            if (!refined || !tiled.Generate(scratch, result, o.n, o.m))
+                return false;
+        }
+        ca.Clear();
+        return true;
+    }
 }
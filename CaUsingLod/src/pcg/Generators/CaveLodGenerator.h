@@ -1,14 +1,17 @@
 /*
 * A cellular automata for cave generation. The cellular automata is based on the generator by Lawrence Johnson, Georgios N. Yannakis, and Julian Togelius.
 * The cellular automata extends upon their design by adding multiple layers of detail.
-* Internally this is done by utilising the Scale function in the CellularAutomata class.
+* Internally this is done by utilising the Scale and Refine functions in the CellularAutomata class.
+* Every level is kept with its seed, so a change to the options or seed of one level only generates that level and the ones above again.
 */
 
 #ifndef PCG_CAVELODGENERATOR_H
 #define PCG_CAVELODGENERATOR_H
 
 #include "pcg/CellularAutomata.h"
+#include "pcg/TiledGrid.h"
 #include "Generator.h"
+#include "Random.h"
 #include <vec3.hpp>
 
 namespace pcg
@@ -26,24 +29,90 @@ namespace pcg
             uint32_t t = 5u;
             uint32_t m = 1u;
             uint32_t multiplier = 3u;
-            std::function<uint32_t(const Options&, const CellularAutomata&, uint32_t, uint32_t)> initializer;
-            std::function<uint32_t(const Options&, const CellularAutomata&, uint32_t, uint32_t)> rule =
-                [](const Options& o, const CellularAutomata& ca, uint32_t x, uint32_t y)
-            {
-                uint32_t neighbourhood = ca.Moore(x, y, o.m, { rock }).size();
-                if (neighbourhood >= o.t)
-                    return rock;
-                return floor;
-            };
+            //Without an initializer or refiner the first layer is r% rock, and every cell of the other layers
+            //is flipped between rock and floor with a chance of r%. These defaults are computed with SIMD kernels.
+            //Random values should come from the given CellRandom, which is keyed by the seed and the index of the layer.
+            std::function<uint32_t(const Options&, const CellularAutomata&, const CellRandom&, uint32_t, uint32_t)> initializer;
+            //Used instead of the initializer on every layer but the first. It is given the type of the parent cell,
+            //and the grid is scaled and initialized in one pass.
+            std::function<uint32_t(const Options&, const CellularAutomata&, const CellRandom&, uint32_t, uint32_t, uint32_t)> refiner;
+            //If no rule is given, a cell becomes rock if at least t rock cells are in its Moore neighbourhood of radius m.
+            //This default is given to the cellular automata as a ThresholdRule, which allows it to use the specialized kernels.
+            //A given rule is called from several threads at once, unless the thread count is set to 1.
+            std::function<uint32_t(const Options&, const CellularAutomata&, uint32_t, uint32_t)> rule;
+            //Without a refiner, only cells near the borders of the layer below are flipped, see CellularAutomata::RefineBorders,
+            //and the uniform tiles away from them are skipped by the first tracked step. The grid is still refined and stepped
+            //in full, so this only pays off at large multipliers, and it is slower at the default multiplier of 3.
+            //The layer differs from a layer refined everywhere.
+            bool sparse = false;
         };
     private:
         std::vector<Options> options;
+        //The grid of every generated level after its steps, and the seed of every level.
+        std::vector<CellularAutomata::Grid> levels;
+        std::vector<uint64_t> levelSeeds;
+
+        //Sets the rule and counting mode of the layer.
+        void SetUpLayer(const Options& o);
+        //Keeps the first levelCount levels and makes the last of them the grid of the automata.
+        void RestoreLevels(uint32_t levelCount);
+        //Initializes the level, or refines the grid of the automata into it, without stepping it.
+        void InitializeLevel(uint32_t level);
+        //Generates the level from the grid of the automata, which must be the level below it, and keeps it.
+        void GenerateLevel(uint32_t level);
+        //Generates the rectangle of the last level from only the cells of every level it depends on.
+        //If bounded, the cells are limited to the map, otherwise the world has no edges.
+        void GenerateCone(uint64_t seed, int64_t x, int64_t y, uint32_t width, uint32_t height, bool bounded);
+    protected:
+        [[nodiscard]]
+        bool GenerateSliced(const std::vector<uint64_t>& seeds) override;
     public:
         CaveLodGenerator(uint32_t width, uint32_t height);
-        void Generate();
+        using Generator::Generate;
+        void Generate(uint64_t seed) override;
         [[nodiscard]]
         std::vector<glm::vec3> GetCellColors() const override;
+        //Changed options take effect on the next call to Generate, or RegenerateFrom(index) to keep the levels below.
         void SetOptions(Options options, uint32_t index);
+        //Generates the levels from the given one on again, starting from the kept level below it.
+        //The result is the same as Generate with the current options and level seeds, but the levels below are not generated again.
+        void RegenerateFrom(uint32_t level);
+        //Gives the levels from the given one on a new seed and generates them again.
+        void RegenerateFrom(uint32_t level, uint64_t seed);
+        //Generates only the given level again with a new seed, starting from the kept level below it.
+        //The levels above are dropped, so the result is the given level. Sweeps over the options of every level use this
+        //to generate a level once and build every variant of the levels above on top of it.
+        void RegenerateLevel(uint32_t level, uint64_t seed);
+        //Number of levels kept from the last generation.
+        [[nodiscard]]
+        uint32_t GetLevelCount() const;
+        [[nodiscard]]
+        CellularAutomata::GridView GetLevel(uint32_t level) const;
+        [[nodiscard]]
+        uint64_t GetLevelSeed(uint32_t level) const;
+        //Generates the rectangle of the last level at the given coordinates in a world without edges.
+        //Every level is generated only in the cells the rectangle depends on, which grow by n * m cells per level
+        //before they are scaled down to the parent cells. The random values are keyed by the coordinates in the world,
+        //so overlapping or adjacent windows with the same seed match exactly. Given initializers and refiners get
+        //coordinates within the window though, so only the default ones give matching windows.
+        //The result is the window, and the levels are not kept.
+        void GenerateWindow(uint64_t seed, int64_t x, int64_t y, uint32_t width, uint32_t height);
+        //Generates the rectangle of the last level of the map from Generate(seed), clipped to the map. The result is the same
+        //as the rectangle cut from the whole map, but every level is only generated in the cells the rectangle depends on,
+        //like GenerateWindow, and limited to the map so its edges follow the boundary. A viewport of a large map costs
+        //a small part of the whole map. With given initializers or refiners, or a wrapping boundary, the whole map is generated
+        //and cut instead. The levels are not kept.
+        void GenerateRegion(uint64_t seed, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+        //Generates the map of Generate(seed) into result, for maps too large to be kept in memory. The first level is generated
+        //in memory, and every level above it is refined and stepped a tile at a time with TiledAutomata,
+        //alternating between result and scratch, whose files are resized. Both must be created with TiledGrid::Create,
+        //and their tile sizes decide how many cells are kept in memory at once. The result is the same as the map of Generate,
+        //but RefineBorders does not skip the uniform tiles of a sparse level, as every tile is stepped on its own.
+        //Returns false, with the result undefined, if a file cannot be resized, or a level above the first has an initializer
+        //or refiner, which would be given coordinates within a tile. A given rule must only read cells within m of the cell.
+        //The levels are not kept, and the result only supports the analyses of TiledAutomata, which has no border or path analyses.
+        [[nodiscard]]
+        bool GenerateTiled(uint64_t seed, TiledGrid& result, TiledGrid& scratch);
     };
 }
 
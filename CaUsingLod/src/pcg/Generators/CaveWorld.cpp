@@ -0,0 +1,192 @@
+#include "CaveWorld.h"
+#include <algorithm>
+
+namespace pcg
+{
+    CaveWorld::CaveWorld(
+        const CaveLodGenerator& generator,
+        uint64_t seed,
+        uint32_t chunkWidth, uint32_t chunkHeight,
+        size_t maxCacheBytes,
+        uint32_t workerCount)
+        : seed(seed), chunkWidth(chunkWidth), chunkHeight(chunkHeight), maxCacheBytes(maxCacheBytes)
+    {
+        //The workers generate chunks side by side, so each of them steps its own chunk on one thread:
+        CaveLodGenerator workerGenerator = generator;
+        workerGenerator.SetThreadCount(1u);
+        for (uint32_t worker = 0u; worker < std::max(workerCount, 1u); worker++)
+            workers.emplace_back(&CaveWorld::Work, this, workerGenerator);
+    }
+
+    CaveWorld::~CaveWorld()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        workReady.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    void CaveWorld::Work(CaveLodGenerator generator)
+    {
+        while (true)
+        {
+            glm::ivec2 coordinates;
+            {
+                std::unique_lock lock(mutex);
+                workReady.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                coordinates = queue.front();
+                queue.pop_front();
+            }
+
+            generator.GenerateWindow(
+                seed,
+                static_cast<int64_t>(coordinates.x) * chunkWidth,
+                static_cast<int64_t>(coordinates.y) * chunkHeight,
+                chunkWidth, chunkHeight);
+            auto chunk = std::make_shared<Chunk>();
+            chunk->coordinates = coordinates;
+            //Chunks are kept without a halo, as they are not stepped again:
+            chunk->cells.Resize(chunkWidth, chunkHeight, 0u);
+            chunk->cells.Assign(generator.GetResult());
+
+            {
+                std::lock_guard lock(mutex);
+                pending.erase(coordinates);
+                Insert(std::move(chunk));
+            }
+            chunkReady.notify_all();
+        }
+    }
+
+    std::shared_ptr<const CaveWorld::Chunk> CaveWorld::Find(glm::ivec2 coordinates)
+    {
+        auto found = chunks.find(coordinates);
+        if (found == chunks.end())
+            return nullptr;
+        recentChunks.splice(recentChunks.begin(), recentChunks, found->second);
+        return *found->second;
+    }
+
+    void CaveWorld::Enqueue(glm::ivec2 coordinates, bool first)
+    {
+        if (chunks.contains(coordinates))
+            return;
+        if (!pending.insert(coordinates).second)
+        {
+            //Queued before, or already being generated if it is not in the queue:
+            auto queued = std::find(queue.begin(), queue.end(), coordinates);
+            if (!first || queued == queue.end())
+                return;
+            queue.erase(queued);
+        }
+        if (first)
+            queue.push_front(coordinates);
+        else
+            queue.push_back(coordinates);
+    }
+
+    void CaveWorld::Insert(std::shared_ptr<const Chunk> chunk)
+    {
+        cacheBytes += chunk->cells.Size() * sizeof(CellularAutomata::CellType);
+        recentChunks.push_front(std::move(chunk));
+        chunks[recentChunks.front()->coordinates] = recentChunks.begin();
+        //The chunk just inserted is kept even if it is beyond the limit alone:
+        while (cacheBytes > maxCacheBytes && recentChunks.size() > 1u)
+        {
+            const auto& oldest = recentChunks.back();
+            cacheBytes -= oldest->cells.Size() * sizeof(CellularAutomata::CellType);
+            chunks.erase(oldest->coordinates);
+            recentChunks.pop_back();
+        }
+    }
+
+    void CaveWorld::Request(glm::ivec2 coordinates)
+    {
+        {
+            std::lock_guard lock(mutex);
+            Enqueue(coordinates, false);
+        }
+        workReady.notify_one();
+    }
+
+    void CaveWorld::Prefetch(glm::ivec2 center, uint32_t radius)
+    {
+        int32_t r = static_cast<int32_t>(radius);
+        std::vector<glm::ivec2> nearby;
+        for (int32_t dy = -r; dy <= r; dy++)
+            for (int32_t dx = -r; dx <= r; dx++)
+                nearby.push_back(center + glm::ivec2(dx, dy));
+        auto distance = [center](glm::ivec2 coordinates)
+        {
+            glm::ivec2 offset = coordinates - center;
+            return offset.x * offset.x + offset.y * offset.y;
+        };
+        std::stable_sort(
+            nearby.begin(), nearby.end(),
+            [&distance](glm::ivec2 first, glm::ivec2 second) { return distance(first) < distance(second); });
+
+        {
+            std::lock_guard lock(mutex);
+            //Pushed to the front farthest first, so the nearest chunk ends up first in the queue:
+            for (auto coordinates = nearby.rbegin(); coordinates != nearby.rend(); coordinates++)
+                Enqueue(*coordinates, true);
+        }
+        workReady.notify_all();
+    }
+
+    std::shared_ptr<const CaveWorld::Chunk> CaveWorld::TryGet(glm::ivec2 coordinates)
+    {
+        std::shared_ptr<const Chunk> chunk;
+        {
+            std::lock_guard lock(mutex);
+            chunk = Find(coordinates);
+            if (!chunk)
+                Enqueue(coordinates, false);
+        }
+        if (!chunk)
+            workReady.notify_one();
+        return chunk;
+    }
+
+    std::shared_ptr<const CaveWorld::Chunk> CaveWorld::Get(glm::ivec2 coordinates)
+    {
+        std::unique_lock lock(mutex);
+        while (true)
+        {
+            if (auto chunk = Find(coordinates))
+                return chunk;
+            //Requested again if the chunk was dropped from the cache before this thread woke up:
+            Enqueue(coordinates, true);
+            workReady.notify_one();
+            chunkReady.wait(lock);
+        }
+    }
+
+    uint32_t CaveWorld::GetChunkWidth() const
+    {
+        return chunkWidth;
+    }
+
+    uint32_t CaveWorld::GetChunkHeight() const
+    {
+        return chunkHeight;
+    }
+
+    size_t CaveWorld::GetCacheBytes()
+    {
+        std::lock_guard lock(mutex);
+        return cacheBytes;
+    }
+
+    size_t CaveWorld::GetPendingCount()
+    {
+        std::lock_guard lock(mutex);
+        return pending.size();
+    }
+}
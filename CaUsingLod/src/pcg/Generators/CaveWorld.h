@@ -0,0 +1,100 @@
+/*
+* A cave world without edges, split into chunks of the last level of a CaveLodGenerator.
+* A chunk is the window of the world at its coordinates, generated with CaveLodGenerator::GenerateWindow,
+* so it only depends on the world seed and its coordinates, and it matches its neighbours exactly.
+* Chunks are generated by background threads, each with a copy of the generator, and kept in a cache.
+* The cache drops the least recently used chunks when it grows beyond its memory limit.
+*/
+
+#ifndef PCG_CAVEWORLD_H
+#define PCG_CAVEWORLD_H
+
+#include "CaveLodGenerator.h"
+#include "Hash.h"
+#include <vec2.hpp>
+#include <memory>
+#include <list>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace pcg
+{
+    class CaveWorld
+    {
+    public:
+        struct Chunk
+        {
+            glm::ivec2 coordinates;
+            CellularAutomata::Grid cells;
+        };
+    private:
+        using ChunkList = std::list<std::shared_ptr<const Chunk>>;
+
+        uint64_t seed;
+        uint32_t chunkWidth;
+        uint32_t chunkHeight;
+        size_t maxCacheBytes;
+        size_t cacheBytes = 0u;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable workReady;
+        std::condition_variable chunkReady;
+        //Chunks waiting for a worker, the next one first.
+        std::deque<glm::ivec2> queue;
+        //Chunks queued or being generated.
+        std::unordered_set<glm::ivec2> pending;
+        //The cached chunks, the most recently used first.
+        ChunkList recentChunks;
+        std::unordered_map<glm::ivec2, ChunkList::iterator> chunks;
+        bool stopping = false;
+
+        void Work(CaveLodGenerator generator);
+        //The mutex must be held by the following functions.
+        //Returns the chunk if it is cached and makes it the most recently used one.
+        [[nodiscard]]
+        std::shared_ptr<const Chunk> Find(glm::ivec2 coordinates);
+        //Queues the chunk unless it is cached or pending. A chunk queued before is moved to the front if first is set.
+        void Enqueue(glm::ivec2 coordinates, bool first);
+        //Caches the chunk and drops the least recently used ones while the cache is beyond its limit.
+        void Insert(std::shared_ptr<const Chunk> chunk);
+    public:
+        //The generator is copied by every worker, so its options can be changed afterwards without affecting the world.
+        //maxCacheBytes is the limit for the cells of the cached chunks. Chunks still held by callers are not counted.
+        CaveWorld(
+            const CaveLodGenerator& generator,
+            uint64_t seed,
+            uint32_t chunkWidth, uint32_t chunkHeight,
+            size_t maxCacheBytes,
+            uint32_t workerCount);
+        CaveWorld(const CaveWorld& other) = delete;
+        CaveWorld& operator=(const CaveWorld& other) = delete;
+        //Waits for the chunks being generated, but drops the queued ones.
+        ~CaveWorld();
+        //Queues the chunk for a worker, unless it is cached or queued already.
+        void Request(glm::ivec2 coordinates);
+        //Queues the chunks within radius chunks of center which are not cached, nearest first, ahead of the ones queued before.
+        //Called as the player moves, so the chunks ahead of the player are ready before they are reached.
+        void Prefetch(glm::ivec2 center, uint32_t radius);
+        //Returns the chunk if it is cached, and requests it otherwise. Never waits for a worker, so it can be called every frame.
+        [[nodiscard]]
+        std::shared_ptr<const Chunk> TryGet(glm::ivec2 coordinates);
+        //Returns the chunk, waiting for a worker to generate it if it is not cached.
+        [[nodiscard]]
+        std::shared_ptr<const Chunk> Get(glm::ivec2 coordinates);
+        [[nodiscard]]
+        uint32_t GetChunkWidth() const;
+        [[nodiscard]]
+        uint32_t GetChunkHeight() const;
+        [[nodiscard]]
+        size_t GetCacheBytes();
+        //Number of chunks queued or being generated.
+        [[nodiscard]]
+        size_t GetPendingCount();
+    };
+}
+
+#endif
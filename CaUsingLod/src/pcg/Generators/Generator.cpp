@@ -1,18 +1,87 @@
 #include "Generator.h"
 #include <geometric.hpp>
 #include "Heuristic.h"
+#include <random>
 
 namespace pcg
 {
+    static std::shared_ptr<ThreadPool> sharedThreadPool()
+    {
+        static std::shared_ptr<ThreadPool> threadPool =
+            std::make_shared<ThreadPool>(ThreadPool::HardwareThreadCount());
+        return threadPool;
+    }
+
     Generator::Generator(uint32_t width, uint32_t height)
-        : initWidth(width), initHeight(height), ca(width, height) { }
+        : initWidth(width), initHeight(height), ca(width, height)
+    {
+        ca.SetThreadPool(sharedThreadPool());
+    }
 
     void Generator::SetCostFunction(CellularAutomata::CostFunction costFunction)
     {
         ca.SetCostFunction(costFunction);
     }
 
-    const std::vector<CellularAutomata::Cell>& Generator::GetResult() const
+    void Generator::SetThreadCount(uint32_t threadCount)
+    {
+        if (threadCount == ThreadPool::HardwareThreadCount())
+            ca.SetThreadPool(sharedThreadPool());
+        else
+            ca.SetThreadCount(threadCount);
+    }
+
+    void Generator::SetBoundary(const Boundary& boundary)
+    {
+        ca.SetBoundary(boundary);
+    }
+
+    void Generator::Generate()
+    {
+        Generate(RandomSeed());
+    }
+
+    uint64_t Generator::RandomSeed()
+    {
+        static std::random_device randomDevice;
+        return (static_cast<uint64_t>(randomDevice()) << 32u) | randomDevice();
+    }
+
+    void Generator::GenerateBatch(const std::vector<uint64_t>& seeds)
+    {
+        size_t count = std::min<size_t>(seeds.size(), CellularAutomata::batchSize);
+        batchSeeds.assign(seeds.begin(), seeds.begin() + count);
+        batchMaps.clear();
+        if (GenerateSliced(batchSeeds))
+            return;
+
+        for (uint64_t batchSeed : batchSeeds)
+        {
+            Generate(batchSeed);
+            batchMaps.emplace_back().Assign(ca.GetCells());
+        }
+    }
+
+    void Generator::SelectBatchMap(uint32_t index)
+    {
+        seed = batchSeeds[index];
+        if (batchMaps.empty())
+            ca.SelectBatchGrid(index);
+        else
+            ca.SetCells(batchMaps[index].GetView());
+    }
+
+    bool Generator::GenerateSliced(const std::vector<uint64_t>&)
+    {
+        return false;
+    }
+
+    uint64_t Generator::GetSeed() const
+    {
+        return seed;
+    }
+
+    CellularAutomata::GridView Generator::GetResult() const
     {
         return ca.GetCells();
     }
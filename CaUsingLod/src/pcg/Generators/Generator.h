@@ -35,16 +35,42 @@ namespace pcg
     {
     private:
         struct NoOptions {};
+        std::vector<uint64_t> batchSeeds;
+        //The maps of the last batch if it could not be generated bitsliced. Empty otherwise.
+        std::vector<CellularAutomata::Grid> batchMaps;
     protected:
         CellularAutomata ca;
         uint32_t initWidth;
         uint32_t initHeight;
+        uint64_t seed = 0u;
+
+        //Generates the maps of the seeds as a batch of the cellular automata, so they are stepped together.
+        //Returns false if the options need something a batch cannot do, in which case every map is generated alone.
+        [[nodiscard]]
+        virtual bool GenerateSliced(const std::vector<uint64_t>& seeds);
     public:
         Generator(uint32_t width, uint32_t height);
         void SetCostFunction(CellularAutomata::CostFunction costFunction);
-        virtual void Generate() = 0;
+        //Generators share one thread pool with a thread per hardware thread by default.
+        void SetThreadCount(uint32_t threadCount);
+        //Decides what lies beyond the edges of the map. By default nothing is counted there.
+        void SetBoundary(const Boundary& boundary);
+        //Generates a map from a new random seed.
+        void Generate();
+        //The same seed and options always give the same map.
+        virtual void Generate(uint64_t seed) = 0;
+        //Generates a map for each of the first CellularAutomata::batchSize seeds together.
+        //The maps are the same as from Generate with the same seeds. SelectBatchMap makes one of them the result.
+        void GenerateBatch(const std::vector<uint64_t>& seeds);
+        //Makes the map of the seed with the given index in the last batch the result, so it can be analysed.
+        void SelectBatchMap(uint32_t index);
+        [[nodiscard]]
+        static uint64_t RandomSeed();
+        //The seed of the last generated map.
+        [[nodiscard]]
+        uint64_t GetSeed() const;
         [[nodiscard]]
-        const std::vector<CellularAutomata::Cell>& GetResult() const;
+        CellularAutomata::GridView GetResult() const;
         [[nodiscard]]
         virtual std::vector<glm::vec3> GetCellColors() const = 0;
         [[nodiscard]]
@@ -175,6 +201,44 @@ namespace pcg
 
     CompType clustering(const AnalysisData& analysisData);
 
+    //Analyses the map of the generator and adds its data point.
+    template<typename GeneratorType>
+    inline void addDataPoint(
+        const GeneratorType& generator,
+        const DataComponent& calculateX,
+        const DataComponent& calculateY,
+        AnalysisData& data)
+    {
+        auto groupAnalyses = generator.AnalyzeGroups();
+        auto bordersAnalyses = generator.AnalyzeBorders();
+        auto pathAnalyses = generator.AnalyzePaths();
+        CellularAutomata::Analysis analysis
+        {
+            groupAnalyses,
+            bordersAnalyses,
+            pathAnalyses
+        };
+        CompType dataPointX = calculateX(generator, analysis);
+        CompType dataPointY = calculateY(generator, analysis);
+        data.minX = std::min(data.minX, dataPointX);
+        data.minY = std::min(data.minY, dataPointY);
+        data.maxX = std::max(data.maxX, dataPointX);
+        data.maxY = std::max(data.maxY, dataPointY);
+        data.dataPoints.push_back({ dataPointX, dataPointY });
+    }
+
+    inline void printDataPointProgress(uint32_t finishedWork, uint32_t totalWork)
+    {
+        std::cout <<
+            "Progress: " <<
+            finishedWork <<
+            " / " <<
+            totalWork <<
+            " iterations completed (" <<
+            static_cast<float>(finishedWork) / totalWork * 100u <<
+            "%)\n";
+    }
+
     template<typename GeneratorType>
     inline AnalysisData dataPoints(
         GeneratorType& generator,
@@ -190,40 +254,73 @@ namespace pcg
         {
             optionSetter(generator, o);
 
+            //Maps are generated in batches, which step many small maps much faster than one at a time:
+            std::vector<uint64_t> seeds;
             for (size_t i = 0ull; i < iterations; i++)
             {
-                generator.Generate();
-                auto groupAnalyses = generator.AnalyzeGroups();
-                auto bordersAnalyses = generator.AnalyzeBorders();
-                auto pathAnalyses = generator.AnalyzePaths();
-                CellularAutomata::Analysis analysis
+                size_t batchIndex = i % CellularAutomata::batchSize;
+                if (batchIndex == 0ull)
                 {
-                    groupAnalyses,
-                    bordersAnalyses,
-                    pathAnalyses
-                };
-                CompType dataPointX = calculateX(generator, analysis);
-                CompType dataPointY = calculateY(generator, analysis);
-                data.minX = std::min(data.minX, dataPointX);
-                data.minY = std::min(data.minY, dataPointY);
-                data.maxX = std::max(data.maxX, dataPointX);
-                data.maxY = std::max(data.maxY, dataPointY);
-                data.dataPoints.push_back({ dataPointX, dataPointY });
-
+                    seeds.resize(std::min<size_t>(CellularAutomata::batchSize, iterations - i));
+                    for (auto& seed : seeds)
+                        seed = Generator::RandomSeed();
+                    generator.GenerateBatch(seeds);
+                }
+                generator.SelectBatchMap(static_cast<uint32_t>(batchIndex));
+                addDataPoint(generator, calculateX, calculateY, data);
                 if (printProgress)
+                    printDataPointProgress(static_cast<uint32_t>(i + o * iterations + 1u), iterations * optionsCount);
+            }
+        }
+        return data;
+    }
+
+    //Like dataPoints for generators with several levels, where every combination of options of the levels is analysed.
+    //Level l has optionCounts[l] options, and optionSetter sets option index of a level. Every combination gets iterations maps.
+    //The combinations are visited as a tree over the levels, where a level generated with one seed on top of a level below it
+    //is shared by every combination of options of the levels above. So each level is generated once per option and prefix,
+    //instead of once per combination. The generator must have RegenerateLevel(level, seed), like CaveLodGenerator.
+    template<typename GeneratorType>
+    inline AnalysisData lodDataPoints(
+        GeneratorType& generator,
+        const std::vector<uint32_t>& optionCounts,
+        DataComponent calculateX,
+        DataComponent calculateY,
+        uint32_t iterations,
+        std::function<void(GeneratorType&, uint32_t, uint32_t)> optionSetter,
+        bool printProgress = false)
+    {
+        AnalysisData data;
+        if (optionCounts.empty())
+            return data;
+        uint32_t combinationCount = 1u;
+        for (uint32_t optionCount : optionCounts)
+            combinationCount *= optionCount;
+        uint32_t totalWork = combinationCount * iterations;
+        uint32_t finishedWork = 0u;
+
+        uint32_t levelCount = static_cast<uint32_t>(optionCounts.size());
+        for (uint32_t i = 0u; i < iterations; i++)
+        {
+            uint64_t seed = Generator::RandomSeed();
+            //Depth first, so the level below the one generated is always kept:
+            auto visit = [&](auto& visit, uint32_t level) -> void
+            {
+                for (uint32_t index = 0u; index < optionCounts[level]; index++)
                 {
-                    uint32_t finishedWork = i + o * iterations + 1u;
-                    uint32_t totalWork = (iterations * optionsCount);
-                    std::cout <<
-                        "Progress: " <<
-                        finishedWork <<
-                        " / " <<
-                        totalWork <<
-                        " iterations completed (" <<
-                        static_cast<float>(finishedWork) / totalWork * 100u <<
-                        "%)\n";
+                    optionSetter(generator, level, index);
+                    generator.RegenerateLevel(level, seed);
+                    if (level + 1u < levelCount)
+                    {
+                        visit(visit, level + 1u);
+                        continue;
+                    }
+                    addDataPoint(generator, calculateX, calculateY, data);
+                    if (printProgress)
+                        printDataPointProgress(++finishedWork, totalWork);
                 }
-            }
+            };
+            visit(visit, 0u);
         }
         return data;
     }
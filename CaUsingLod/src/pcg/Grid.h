@@ -0,0 +1,385 @@
+/*
+* Compact storage for the cells of a cellular automata.
+* Only the type of each cell is stored. The position of a cell is derived from its index.
+* The width of the stored type is given by the template parameter.
+* A grid can carry a halo of cells around the live area. The halo is filled following a boundary policy,
+* which lets kernels read the neighbours of edge cells without checking the bounds of the grid.
+* BasicGridView is a lightweight, non-owning view used for reading the cells of a grid.
+*/
+
+#ifndef PCG_GRID_H
+#define PCG_GRID_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vec2.hpp>
+
+namespace pcg
+{
+    //The type of the cells outside the grid under the default boundary policy.
+    //No rule counts it, so cells outside the grid count as nothing. Cell types must stay below it.
+    inline constexpr uint32_t voidType = 255u;
+
+    enum class BoundaryPolicy
+    {
+        //Cells outside the grid have the fill type.
+        Fill,
+        //Cells outside the grid have the type of the nearest cell of the grid.
+        Clamp,
+        //The grid repeats itself, so cells outside the grid have the type of the cell on the opposite side.
+        Wrap
+    };
+
+    struct Boundary
+    {
+        BoundaryPolicy policy = BoundaryPolicy::Fill;
+        uint32_t fillType = voidType;
+        //Width of the halo around the grid. Kernels only read the halo for neighbourhoods up to this radius.
+        uint32_t haloSize = 7u;
+
+        //Maps a coordinate outside [0, size) to the coordinate it reads from. Returns false if it reads the fill type.
+        [[nodiscard]]
+        bool Map(int32_t& coordinate, int32_t size) const;
+    };
+
+    template<typename T>
+    class BasicGridView
+    {
+    private:
+        const T* cells = nullptr;
+        uint32_t width = 0u;
+        uint32_t height = 0u;
+        uint32_t stride = 0u;
+        uint32_t halo = 0u;
+    public:
+        BasicGridView() = default;
+        BasicGridView(const T* cells, uint32_t width, uint32_t height);
+        //cells points to the first live cell. Rows are stride cells apart and have halo cells on every side.
+        BasicGridView(const T* cells, uint32_t width, uint32_t height, uint32_t stride, uint32_t halo);
+        [[nodiscard]]
+        uint32_t Get(uint32_t x, uint32_t y) const;
+        [[nodiscard]]
+        uint32_t operator[](size_t index) const;
+        [[nodiscard]]
+        glm::uvec2 Position(size_t index) const;
+        //Rows from -halo to height + halo - 1 can be read. Cells from -halo to width + halo - 1 of a row can be read.
+        [[nodiscard]]
+        const T* Row(int32_t y) const;
+        [[nodiscard]]
+        uint32_t GetWidth() const;
+        [[nodiscard]]
+        uint32_t GetHeight() const;
+        [[nodiscard]]
+        uint32_t GetStride() const;
+        [[nodiscard]]
+        uint32_t GetHalo() const;
+        [[nodiscard]]
+        size_t Size() const;
+        //A view treating the halo as part of the grid.
+        [[nodiscard]]
+        BasicGridView<T> WithHalo() const;
+    };
+
+    template<typename T>
+    class BasicGrid
+    {
+    private:
+        std::vector<T> cells;
+        uint32_t width = 0u;
+        uint32_t height = 0u;
+        uint32_t halo = 0u;
+        uint32_t stride = 0u;
+
+        [[nodiscard]]
+        size_t Index(int32_t x, int32_t y) const;
+    public:
+        using ValueType = T;
+
+        BasicGrid() = default;
+        BasicGrid(uint32_t width, uint32_t height, uint32_t halo = 0u);
+        //Keeps the size of the halo.
+        void Resize(uint32_t width, uint32_t height);
+        void Resize(uint32_t width, uint32_t height, uint32_t halo);
+        //Copies the live cells of the view, which may have another size. Keeps the size of the halo, but not its cells.
+        void Assign(BasicGridView<T> cells);
+        //Fills the live cells and the halo.
+        void Fill(uint32_t type);
+        void Set(uint32_t type, uint32_t x, uint32_t y);
+        //Also sets the cells of the halo which read from the cell following the boundary, so the halo stays up to date.
+        void Set(uint32_t type, uint32_t x, uint32_t y, const Boundary& boundary);
+        //Fills the halo from the live cells following the boundary. The halo size of the boundary is ignored.
+        void UpdateHalo(const Boundary& boundary);
+        [[nodiscard]]
+        uint32_t Get(uint32_t x, uint32_t y) const;
+        [[nodiscard]]
+        T* Row(int32_t y);
+        [[nodiscard]]
+        const T* Row(int32_t y) const;
+        [[nodiscard]]
+        uint32_t GetWidth() const;
+        [[nodiscard]]
+        uint32_t GetHeight() const;
+        [[nodiscard]]
+        uint32_t GetHalo() const;
+        [[nodiscard]]
+        size_t Size() const;
+        [[nodiscard]]
+        BasicGridView<T> GetView() const;
+    };
+
+    inline bool Boundary::Map(int32_t& coordinate, int32_t size) const
+    {
+        if (coordinate >= 0 && coordinate < size)
+            return true;
+        switch (policy)
+        {
+        case BoundaryPolicy::Clamp:
+            coordinate = std::clamp(coordinate, 0, size - 1);
+            return true;
+        case BoundaryPolicy::Wrap:
+            coordinate = ((coordinate % size) + size) % size;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    template<typename T>
+    inline BasicGridView<T>::BasicGridView(const T* cells, uint32_t width, uint32_t height)
+        : cells(cells), width(width), height(height), stride(width) { }
+
+    template<typename T>
+    inline BasicGridView<T>::BasicGridView(const T* cells, uint32_t width, uint32_t height, uint32_t stride, uint32_t halo)
+        : cells(cells), width(width), height(height), stride(stride), halo(halo) { }
+
+    template<typename T>
+    inline uint32_t BasicGridView<T>::Get(uint32_t x, uint32_t y) const
+    {
+        return cells[x + static_cast<size_t>(y) * stride];
+    }
+
+    template<typename T>
+    inline uint32_t BasicGridView<T>::operator[](size_t index) const
+    {
+        return Get(static_cast<uint32_t>(index % width), static_cast<uint32_t>(index / width));
+    }
+
+    template<typename T>
+    inline glm::uvec2 BasicGridView<T>::Position(size_t index) const
+    {
+        return { index % width, index / width };
+    }
+
+    template<typename T>
+    inline const T* BasicGridView<T>::Row(int32_t y) const
+    {
+        return cells + static_cast<ptrdiff_t>(y) * stride;
+    }
+
+    template<typename T>
+    inline uint32_t BasicGridView<T>::GetWidth() const
+    {
+        return width;
+    }
+
+    template<typename T>
+    inline uint32_t BasicGridView<T>::GetHeight() const
+    {
+        return height;
+    }
+
+    template<typename T>
+    inline uint32_t BasicGridView<T>::GetStride() const
+    {
+        return stride;
+    }
+
+    template<typename T>
+    inline uint32_t BasicGridView<T>::GetHalo() const
+    {
+        return halo;
+    }
+
+    template<typename T>
+    inline size_t BasicGridView<T>::Size() const
+    {
+        return static_cast<size_t>(width) * height;
+    }
+
+    template<typename T>
+    inline BasicGridView<T> BasicGridView<T>::WithHalo() const
+    {
+        return BasicGridView<T>(Row(-static_cast<int32_t>(halo)) - halo, width + 2u * halo, height + 2u * halo, stride, 0u);
+    }
+
+    template<typename T>
+    inline BasicGrid<T>::BasicGrid(uint32_t width, uint32_t height, uint32_t halo)
+    {
+        Resize(width, height, halo);
+    }
+
+    template<typename T>
+    inline size_t BasicGrid<T>::Index(int32_t x, int32_t y) const
+    {
+        return static_cast<size_t>(x + static_cast<int32_t>(halo)) +
+            static_cast<size_t>(y + static_cast<int32_t>(halo)) * stride;
+    }
+
+    template<typename T>
+    inline void BasicGrid<T>::Resize(uint32_t width, uint32_t height)
+    {
+        Resize(width, height, halo);
+    }
+
+    template<typename T>
+    inline void BasicGrid<T>::Resize(uint32_t width, uint32_t height, uint32_t halo)
+    {
+        this->width = width;
+        this->height = height;
+        this->halo = halo;
+        stride = width + 2u * halo;
+        cells.resize(static_cast<size_t>(stride) * (height + 2u * halo));
+    }
+
+    template<typename T>
+    inline void BasicGrid<T>::Assign(BasicGridView<T> cells)
+    {
+        Resize(cells.GetWidth(), cells.GetHeight());
+        for (uint32_t y = 0u; y < height; y++)
+            std::copy_n(cells.Row(y), width, Row(y));
+    }
+
+    template<typename T>
+    inline void BasicGrid<T>::Fill(uint32_t type)
+    {
+        std::fill(cells.begin(), cells.end(), static_cast<T>(type));
+    }
+
+    template<typename T>
+    inline void BasicGrid<T>::Set(uint32_t type, uint32_t x, uint32_t y)
+    {
+        cells[Index(static_cast<int32_t>(x), static_cast<int32_t>(y))] = static_cast<T>(type);
+    }
+
+    template<typename T>
+    inline void BasicGrid<T>::Set(uint32_t type, uint32_t x, uint32_t y, const Boundary& boundary)
+    {
+        Set(type, x, y);
+        if (x >= halo && x + halo < width && y >= halo && y + halo < height)
+            return;
+        int32_t sh = static_cast<int32_t>(halo);
+
+        //Visits the coordinate itself and every coordinate of the halo mapped to it:
+        auto forEachReader = [&boundary, sh](int32_t source, int32_t size, auto&& visit)
+        {
+            visit(source);
+            for (int32_t c = -sh; c < size + sh; c++)
+            {
+                if (c == 0)
+                    c = size;
+                int32_t mapped = c;
+                if (boundary.Map(mapped, size) && mapped == source)
+                    visit(c);
+            }
+        };
+        forEachReader(static_cast<int32_t>(y), static_cast<int32_t>(height), [&](int32_t readerY)
+            {
+                T* row = Row(readerY);
+                forEachReader(static_cast<int32_t>(x), static_cast<int32_t>(width), [&](int32_t readerX)
+                    {
+                        row[readerX] = static_cast<T>(type);
+                    });
+            });
+    }
+
+    template<typename T>
+    inline void BasicGrid<T>::UpdateHalo(const Boundary& boundary)
+    {
+        if (halo == 0u || width == 0u || height == 0u)
+            return;
+        int32_t sh = static_cast<int32_t>(halo);
+        int32_t sw = static_cast<int32_t>(width);
+        int32_t sHeight = static_cast<int32_t>(height);
+
+        //The left and right parts of the live rows:
+        for (int32_t y = 0; y < sHeight; y++)
+        {
+            T* row = Row(y);
+            for (int32_t x = -sh; x < 0; x++)
+            {
+                int32_t source = x;
+                row[x] = boundary.Map(source, sw) ? row[source] : static_cast<T>(boundary.fillType);
+            }
+            for (int32_t x = sw; x < sw + sh; x++)
+            {
+                int32_t source = x;
+                row[x] = boundary.Map(source, sw) ? row[source] : static_cast<T>(boundary.fillType);
+            }
+        }
+
+        //Whole rows above and below, including the corners, copied from the rows completed above:
+        for (int32_t y = -sh; y < sHeight + sh; y++)
+        {
+            if (y == 0)
+                y = sHeight;
+            int32_t source = y;
+            T* row = Row(y) - halo;
+            if (boundary.Map(source, sHeight))
+                std::copy_n(Row(source) - halo, stride, row);
+            else
+                std::fill_n(row, stride, static_cast<T>(boundary.fillType));
+        }
+    }
+
+    template<typename T>
+    inline uint32_t BasicGrid<T>::Get(uint32_t x, uint32_t y) const
+    {
+        return cells[Index(static_cast<int32_t>(x), static_cast<int32_t>(y))];
+    }
+
+    template<typename T>
+    inline T* BasicGrid<T>::Row(int32_t y)
+    {
+        return cells.data() + Index(0, y);
+    }
+
+    template<typename T>
+    inline const T* BasicGrid<T>::Row(int32_t y) const
+    {
+        return cells.data() + Index(0, y);
+    }
+
+    template<typename T>
+    inline uint32_t BasicGrid<T>::GetWidth() const
+    {
+        return width;
+    }
+
+    template<typename T>
+    inline uint32_t BasicGrid<T>::GetHeight() const
+    {
+        return height;
+    }
+
+    template<typename T>
+    inline uint32_t BasicGrid<T>::GetHalo() const
+    {
+        return halo;
+    }
+
+    template<typename T>
+    inline size_t BasicGrid<T>::Size() const
+    {
+        return static_cast<size_t>(width) * height;
+    }
+
+    template<typename T>
+    inline BasicGridView<T> BasicGrid<T>::GetView() const
+    {
+        return BasicGridView<T>(Row(0), width, height, stride, halo);
+    }
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "HistogramKernel.h"
+#include <algorithm>
+#include <cstring>
+
+namespace pcg
+{
+    using Counts = HistogramRule::Counts;
+
+    //The counts are added four at a time as 64-bit words, which works at every optimization level and on every processor.
+    //No count ever leaves [0, 65535], so no carry or borrow crosses into the neighbouring count.
+    static constexpr uint32_t countWords = sizeof(Counts) / sizeof(uint64_t);
+
+    static void addCounts(Counts& counts, const Counts& other)
+    {
+        uint64_t words[countWords];
+        uint64_t otherWords[countWords];
+        std::memcpy(words, counts.data(), sizeof(Counts));
+        std::memcpy(otherWords, other.data(), sizeof(Counts));
+        for (uint32_t i = 0u; i < countWords; i++)
+            words[i] += otherWords[i];
+        std::memcpy(counts.data(), words, sizeof(Counts));
+    }
+
+    static void subtractCounts(Counts& counts, const Counts& other)
+    {
+        uint64_t words[countWords];
+        uint64_t otherWords[countWords];
+        std::memcpy(words, counts.data(), sizeof(Counts));
+        std::memcpy(otherWords, other.data(), sizeof(Counts));
+        for (uint32_t i = 0u; i < countWords; i++)
+            words[i] -= otherWords[i];
+        std::memcpy(counts.data(), words, sizeof(Counts));
+    }
+
+    //Adds delta to the count of the type of every cell of the row, for the columns from -m to width + m - 1.
+    static void countRow(
+        const uint8_t* row, uint32_t columnCount, uint32_t typeCount,
+        uint16_t delta, std::vector<Counts>& columnCounts)
+    {
+        for (uint32_t column = 0u; column < columnCount; column++)
+        {
+            uint32_t type = row[column];
+            if (type < typeCount)
+                columnCounts[column][type] += delta;
+        }
+    }
+
+    void stepHistogramRule(
+        BasicGridView<uint8_t> cells,
+        BasicGrid<uint8_t>& nextCells,
+        const HistogramRule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        std::vector<Counts>& columnCounts)
+    {
+        uint32_t width = cells.GetWidth();
+        if (width == 0u || rowBegin >= rowEnd)
+            return;
+        uint32_t m = rule.m;
+        int32_t sm = static_cast<int32_t>(m);
+        uint32_t side = 2u * m + 1u;
+        uint32_t columnCount = width + 2u * m;
+        uint32_t typeCount = std::min(rule.typeCount, HistogramRule::maxTypeCount);
+        //The counts wrap around, so adding the largest count removes one.
+        uint16_t removed = static_cast<uint16_t>(-1);
+
+        //The column counts start with the rows above the first row of the band, and the row entering its neighbourhood is added per row:
+        columnCounts.assign(columnCount, Counts{});
+        int32_t sRowBegin = static_cast<int32_t>(rowBegin);
+        for (int32_t y = sRowBegin - sm; y < sRowBegin + sm; y++)
+            countRow(cells.Row(y) - m, columnCount, typeCount, 1u, columnCounts);
+
+        for (uint32_t y = rowBegin; y < rowEnd; y++)
+        {
+            int32_t sy = static_cast<int32_t>(y);
+            countRow(cells.Row(sy + sm) - m, columnCount, typeCount, 1u, columnCounts);
+
+            //The window of cell x holds the columns [x, x + 2m] of the column counts:
+            Counts counts{};
+            for (uint32_t column = 0u; column + 1u < side; column++)
+                addCounts(counts, columnCounts[column]);
+            const uint8_t* row = cells.Row(sy);
+            uint8_t* nextRow = nextCells.Row(sy);
+            for (uint32_t x = 0u; x < width; x++)
+            {
+                addCounts(counts, columnCounts[x + side - 1u]);
+                nextRow[x] = static_cast<uint8_t>(rule.next(row[x], counts.data(), x, y));
+                subtractCounts(counts, columnCounts[x]);
+            }
+
+            countRow(cells.Row(sy - sm) - m, columnCount, typeCount, removed, columnCounts);
+        }
+    }
+}
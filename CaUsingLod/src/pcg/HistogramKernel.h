@@ -0,0 +1,31 @@
+/*
+* Stepping kernel for rules given the neighbour count of every type, see HistogramRule.
+* The kernel keeps the counts of every type per column while moving down the grid, where each new row adds one count
+* to a column and the row leaving the neighbourhood removes one. The counts of a cell are then kept with a sliding window
+* over the columns, which adds the column entering the window and subtracts the column leaving it.
+* The cost per cell is independent of the radius, and the counts of all types are added as one short vector.
+*/
+
+#ifndef PCG_HISTOGRAMKERNEL_H
+#define PCG_HISTOGRAMKERNEL_H
+
+#include <vector>
+#include <cstdint>
+#include "Grid.h"
+#include "Rules.h"
+
+namespace pcg
+{
+    //Writes the next types of the rows [rowBegin, rowEnd) into nextCells, which must already have the size of cells.
+    //The neighbourhood may read the halo of cells, so the halo must be at least rule.m and up to date.
+    //columnCounts is scratch memory which keeps its capacity between calls.
+    //Bands of rows can be stepped concurrently as long as each has its own columnCounts.
+    void stepHistogramRule(
+        BasicGridView<uint8_t> cells,
+        BasicGrid<uint8_t>& nextCells,
+        const HistogramRule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        std::vector<HistogramRule::Counts>& columnCounts);
+}
+
+#endif
@@ -0,0 +1,345 @@
+#include "Quadtree.h"
+#include "RuleKernels.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+
+namespace pcg
+{
+    size_t Quadtree::LeafHash::operator()(const Leaf& leaf) const
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0u; i < leaf.size(); i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, leaf.data() + i, sizeof(uint64_t));
+            hash = (hash ^ word) * 0x100000001b3ull;
+            hash ^= hash >> 32u;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    size_t Quadtree::ChildrenHash::operator()(const std::array<NodeId, 4>& children) const
+    {
+        uint64_t north = (static_cast<uint64_t>(children[0]) << 32u) | children[1];
+        uint64_t south = (static_cast<uint64_t>(children[2]) << 32u) | children[3];
+        uint64_t hash = north * 0x9e3779b97f4a7c15ull ^ south * 0xc2b2ae3d27d4eb4full;
+        return static_cast<size_t>(hash ^ (hash >> 29u));
+    }
+
+    void Quadtree::Reset(const OuterTotalisticRule& rule, const RuleTable& table, uint32_t fillType)
+    {
+        this->table = table;
+        neighbourhood = rule.neighbourhood;
+        m = rule.m;
+        countedType = rule.countedType;
+        this->fillType = fillType;
+
+        //The base level must be large enough to advance at least one generation:
+        uint32_t margin = std::max(m, 1u);
+        baseLevel = leafLevel + 1u;
+        while ((1u << (baseLevel - 2u)) < margin)
+            baseLevel++;
+        Forget();
+    }
+
+    void Quadtree::Advance(BasicGrid<uint8_t>& cells, uint32_t generations)
+    {
+        uint32_t width = cells.GetWidth();
+        uint32_t height = cells.GetHeight();
+        if (generations == 0u || width == 0u || height == 0u)
+            return;
+        if (nodes.size() > maxNodeCount)
+            Forget();
+
+        //The grid is placed in the centre of the root, which is advanced in one call:
+        uint32_t level = baseLevel + 1u;
+        while ((uint64_t(1u) << (level - 1u)) < std::max(width, height) || MaxGenerations(level) < generations)
+            level++;
+        int64_t offset = int64_t(1) << (level - 2u);
+        NodeId root = Build(cells.GetView(), -offset, -offset, level);
+        Write(Advance(root, generations), 0, 0, cells);
+    }
+
+    size_t Quadtree::GetNodeCount() const
+    {
+        return nodes.size();
+    }
+
+    void Quadtree::Forget()
+    {
+        nodes.clear();
+        leaves.clear();
+        leafIds.clear();
+        innerIds.clear();
+        results.clear();
+        voidNodes.clear();
+    }
+
+    Quadtree::NodeId Quadtree::MakeLeaf(const Leaf& leaf)
+    {
+        auto [it, inserted] = leafIds.try_emplace(leaf, static_cast<NodeId>(nodes.size()));
+        if (inserted)
+        {
+            nodes.push_back({ leafLevel, { static_cast<NodeId>(leaves.size()), 0u, 0u, 0u } });
+            leaves.push_back(leaf);
+        }
+        return it->second;
+    }
+
+    Quadtree::NodeId Quadtree::MakeInner(NodeId nw, NodeId ne, NodeId sw, NodeId se)
+    {
+        std::array<NodeId, 4> children{ nw, ne, sw, se };
+        auto [it, inserted] = innerIds.try_emplace(children, static_cast<NodeId>(nodes.size()));
+        if (inserted)
+            nodes.push_back({ nodes[nw].level + 1u, children });
+        return it->second;
+    }
+
+    Quadtree::NodeId Quadtree::VoidNode(uint32_t level)
+    {
+        while (voidNodes.size() <= level - leafLevel)
+        {
+            if (voidNodes.empty())
+            {
+                Leaf leaf;
+                leaf.fill(static_cast<uint8_t>(voidType));
+                voidNodes.push_back(MakeLeaf(leaf));
+                continue;
+            }
+            NodeId child = voidNodes.back();
+            voidNodes.push_back(MakeInner(child, child, child, child));
+        }
+        return voidNodes[level - leafLevel];
+    }
+
+    Quadtree::NodeId Quadtree::Build(BasicGridView<uint8_t> cells, int64_t x, int64_t y, uint32_t level)
+    {
+        int64_t size = int64_t(1) << level;
+        if (x >= cells.GetWidth() || y >= cells.GetHeight() || x + size <= 0 || y + size <= 0)
+            return VoidNode(level);
+        if (level == leafLevel)
+        {
+            Leaf leaf;
+            for (int64_t dy = 0; dy < size; dy++)
+            {
+                int64_t cellY = y + dy;
+                bool rowInside = cellY >= 0 && cellY < cells.GetHeight();
+                const uint8_t* row = rowInside ? cells.Row(static_cast<int32_t>(cellY)) : nullptr;
+                for (int64_t dx = 0; dx < size; dx++)
+                {
+                    int64_t cellX = x + dx;
+                    bool inside = rowInside && cellX >= 0 && cellX < cells.GetWidth();
+                    leaf[dy * size + dx] = inside ? row[cellX] : static_cast<uint8_t>(voidType);
+                }
+            }
+            return MakeLeaf(leaf);
+        }
+        int64_t half = size / 2;
+        NodeId nw = Build(cells, x, y, level - 1u);
+        NodeId ne = Build(cells, x + half, y, level - 1u);
+        NodeId sw = Build(cells, x, y + half, level - 1u);
+        NodeId se = Build(cells, x + half, y + half, level - 1u);
+        return MakeInner(nw, ne, sw, se);
+    }
+
+    void Quadtree::Write(NodeId node, int64_t x, int64_t y, BasicGrid<uint8_t>& cells) const
+    {
+        const Node& n = nodes[node];
+        int64_t size = int64_t(1) << n.level;
+        int64_t width = cells.GetWidth();
+        int64_t height = cells.GetHeight();
+        if (x >= width || y >= height || x + size <= 0 || y + size <= 0)
+            return;
+        if (n.level == leafLevel)
+        {
+            const Leaf& leaf = leaves[n.children[0]];
+            int64_t x0 = std::max<int64_t>(x, 0);
+            int64_t x1 = std::min(x + size, width);
+            for (int64_t cellY = std::max<int64_t>(y, 0); cellY < std::min(y + size, height); cellY++)
+                std::copy(
+                    leaf.data() + (cellY - y) * size + (x0 - x),
+                    leaf.data() + (cellY - y) * size + (x1 - x),
+                    cells.Row(static_cast<int32_t>(cellY)) + x0);
+            return;
+        }
+        int64_t half = size / 2;
+        Write(n.children[0], x, y, cells);
+        Write(n.children[1], x + half, y, cells);
+        Write(n.children[2], x, y + half, cells);
+        Write(n.children[3], x + half, y + half, cells);
+    }
+
+    void Quadtree::Expand(NodeId node, uint8_t* cells, size_t stride) const
+    {
+        const Node& n = nodes[node];
+        if (n.level == leafLevel)
+        {
+            const Leaf& leaf = leaves[n.children[0]];
+            for (size_t y = 0u; y < leafSize; y++)
+                std::copy_n(leaf.data() + y * leafSize, leafSize, cells + y * stride);
+            return;
+        }
+        size_t half = size_t(1u) << (n.level - 1u);
+        Expand(n.children[0], cells, stride);
+        Expand(n.children[1], cells + half, stride);
+        Expand(n.children[2], cells + half * stride, stride);
+        Expand(n.children[3], cells + half * stride + half, stride);
+    }
+
+    Quadtree::NodeId Quadtree::Collapse(const uint8_t* cells, size_t stride, uint32_t level)
+    {
+        if (level == leafLevel)
+        {
+            Leaf leaf;
+            for (size_t y = 0u; y < leafSize; y++)
+                std::copy_n(cells + y * stride, leafSize, leaf.data() + y * leafSize);
+            return MakeLeaf(leaf);
+        }
+        size_t half = size_t(1u) << (level - 1u);
+        NodeId nw = Collapse(cells, stride, level - 1u);
+        NodeId ne = Collapse(cells + half, stride, level - 1u);
+        NodeId sw = Collapse(cells + half * stride, stride, level - 1u);
+        NodeId se = Collapse(cells + half * stride + half, stride, level - 1u);
+        return MakeInner(nw, ne, sw, se);
+    }
+
+    uint32_t Quadtree::MaxGenerations(uint32_t level) const
+    {
+        if (level < baseLevel)
+            return 0u;
+        //The centre of a node is a quarter of its size away from its edges, and errors from outside spread m cells per generation.
+        uint64_t generations = (uint64_t(1u) << (baseLevel - 2u)) / std::max(m, 1u);
+        for (uint32_t k = baseLevel; k < level && generations < std::numeric_limits<uint32_t>::max(); k++)
+            generations *= 2u;
+        return static_cast<uint32_t>(std::min<uint64_t>(generations, std::numeric_limits<uint32_t>::max()));
+    }
+
+    Quadtree::NodeId Quadtree::Centre(NodeId node)
+    {
+        Node n = nodes[node];
+        if (n.level == leafLevel + 1u)
+        {
+            std::array<uint8_t, 4u * leafSize * leafSize> block;
+            size_t size = 2u * leafSize;
+            Expand(node, block.data(), size);
+            return Collapse(block.data() + leafSize / 2u * size + leafSize / 2u, size, leafLevel);
+        }
+        return MakeInner(
+            nodes[n.children[0]].children[3],
+            nodes[n.children[1]].children[2],
+            nodes[n.children[2]].children[1],
+            nodes[n.children[3]].children[0]);
+    }
+
+    Quadtree::NodeId Quadtree::Advance(NodeId node, uint32_t generations)
+    {
+        uint32_t level = nodes[node].level;
+        //Cells outside the grid never change:
+        if (node == VoidNode(level))
+            return VoidNode(level - 1u);
+        if (generations == 0u)
+            return Centre(node);
+        uint64_t key = (static_cast<uint64_t>(node) << 32u) | generations;
+        if (auto it = results.find(key); it != results.end())
+            return it->second;
+
+        if (level == baseLevel)
+        {
+            NodeId result = AdvanceBase(node, generations);
+            results.emplace(key, result);
+            return result;
+        }
+
+        //The grandchildren as a 4 * 4 block of nodes:
+        std::array<std::array<NodeId, 4>, 4> grandchildren;
+        std::array<NodeId, 4> children = nodes[node].children;
+        for (uint32_t i = 0u; i < 4u; i++)
+        {
+            std::array<NodeId, 4> c = nodes[children[i]].children;
+            uint32_t row = i / 2u * 2u;
+            uint32_t column = i % 2u * 2u;
+            grandchildren[row][column] = c[0];
+            grandchildren[row][column + 1u] = c[1];
+            grandchildren[row + 1u][column] = c[2];
+            grandchildren[row + 1u][column + 1u] = c[3];
+        }
+
+        //Nine overlapping nodes one level down are advanced by the first part of the generations, which leaves a 3 * 3 block
+        //covering the centre. Four overlapping nodes of that block are then advanced by the rest.
+        uint32_t firstGenerations = std::min(generations, MaxGenerations(level - 1u));
+        std::array<std::array<NodeId, 3>, 3> advanced;
+        for (uint32_t y = 0u; y < 3u; y++)
+            for (uint32_t x = 0u; x < 3u; x++)
+                advanced[y][x] = Advance(
+                    MakeInner(
+                        grandchildren[y][x], grandchildren[y][x + 1u],
+                        grandchildren[y + 1u][x], grandchildren[y + 1u][x + 1u]),
+                    firstGenerations);
+        std::array<NodeId, 4> quarters;
+        for (uint32_t y = 0u; y < 2u; y++)
+            for (uint32_t x = 0u; x < 2u; x++)
+                quarters[y * 2u + x] = Advance(
+                    MakeInner(advanced[y][x], advanced[y][x + 1u], advanced[y + 1u][x], advanced[y + 1u][x + 1u]),
+                    generations - firstGenerations);
+        NodeId result = MakeInner(quarters[0], quarters[1], quarters[2], quarters[3]);
+        results.emplace(key, result);
+        return result;
+    }
+
+    Quadtree::NodeId Quadtree::AdvanceBase(NodeId node, uint32_t generations)
+    {
+        //The grids hold the node with its outer m cells as the halo, so the kernels of RuleKernels.h can step it.
+        uint32_t size = 1u << baseLevel;
+        uint32_t innerSize = size - 2u * m;
+        int32_t r = static_cast<int32_t>(m);
+        baseCells.Resize(innerSize, innerSize, m);
+        nextBaseCells.Resize(innerSize, innerSize, m);
+        Expand(node, baseCells.Row(-r) - r, size);
+
+        auto rule = [function = TableFunction(table)](uint32_t cellType, uint32_t count)
+        {
+            return cellType == voidType ? voidType : function(cellType, count);
+        };
+        //The compiled kernels only count cells equal to countedType, so they cannot count cells outside the grid as fillType.
+        bool compiled = fillType != countedType && countedType < voidType && m <= maxCompiledRadius;
+        std::array<uint8_t, 256> counted{};
+        counted[countedType & 255u] = countedType < voidType;
+        counted[voidType] = fillType == countedType;
+
+        for (uint32_t i = 0u; i < generations; i++)
+        {
+            //The cells which can be computed shrink by m on every side each generation:
+            uint32_t begin = i * m;
+            uint32_t end = innerSize - i * m;
+            if (compiled)
+            {
+                (void)stepRowsCompiled<ReadHalo>(
+                    neighbourhood, m, baseCells.GetView(), nextBaseCells, countedType, rule, begin, end, begin, end);
+                std::swap(baseCells, nextBaseCells);
+                continue;
+            }
+            for (uint32_t y = begin; y < end; y++)
+            {
+                const uint8_t* row = baseCells.Row(static_cast<int32_t>(y));
+                uint8_t* nextRow = nextBaseCells.Row(static_cast<int32_t>(y));
+                for (uint32_t x = begin; x < end; x++)
+                {
+                    uint32_t count = 0u;
+                    for (int32_t dy = -r; dy <= r; dy++)
+                    {
+                        const uint8_t* neighbours = row + x + static_cast<ptrdiff_t>(dy) * size;
+                        int32_t rowRadius = neighbourhood == Neighbourhood::Moore ? r : r - std::abs(dy);
+                        for (int32_t dx = -rowRadius; dx <= rowRadius; dx++)
+                            count += counted[neighbours[dx]];
+                    }
+                    nextRow[x] = static_cast<uint8_t>(rule(row[x], count));
+                }
+            }
+            std::swap(baseCells, nextBaseCells);
+        }
+        int32_t centre = static_cast<int32_t>(size / 4u) - r;
+        return Collapse(baseCells.Row(centre) + centre, size, baseLevel - 1u);
+    }
+}
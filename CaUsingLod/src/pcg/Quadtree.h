@@ -0,0 +1,115 @@
+/*
+* Stores a grid as a quadtree where identical blocks are stored once, and advances it in the style of Hashlife.
+* A node of level k covers 2^k * 2^k cells. Leaves are blocks of 8 * 8 cells and every other node refers to four children.
+* Nodes are hash-consed, so a block which appears many times, like an empty or a solid region, is one node.
+* Advancing a node gives its centre some generations later. The results are memoized per node,
+* so every repeated block of the grid is only advanced once, no matter how often it appears or how many generations are run.
+* This works for outer totalistic rules of any radius m, since a node of level k can be advanced 2^(k-2) / m generations
+* without reading outside of it.
+*/
+
+#ifndef PCG_QUADTREE_H
+#define PCG_QUADTREE_H
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include "Grid.h"
+#include "Rules.h"
+
+namespace pcg
+{
+    class Quadtree
+    {
+    public:
+        using NodeId = uint32_t;
+        //Leaves are blocks of 2^leafLevel * 2^leafLevel cells.
+        static constexpr uint32_t leafLevel = 3u;
+        static constexpr uint32_t leafSize = 1u << leafLevel;
+        //Everything is forgotten when an advance starts with more nodes than this, which bounds the memory used.
+        static constexpr size_t maxNodeCount = size_t(1u) << 22u;
+    private:
+        using Leaf = std::array<uint8_t, leafSize * leafSize>;
+
+        struct Node
+        {
+            uint32_t level;
+            //For leaves, the first child is the index of the cells in leaves.
+            std::array<NodeId, 4> children;
+        };
+
+        struct LeafHash
+        {
+            [[nodiscard]]
+            size_t operator()(const Leaf& leaf) const;
+        };
+
+        struct ChildrenHash
+        {
+            [[nodiscard]]
+            size_t operator()(const std::array<NodeId, 4>& children) const;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<Leaf> leaves;
+        std::unordered_map<Leaf, NodeId, LeafHash> leafIds;
+        std::unordered_map<std::array<NodeId, 4>, NodeId, ChildrenHash> innerIds;
+        //Maps a node and a number of generations, packed as (node << 32) | generations, to the advanced centre of the node.
+        std::unordered_map<uint64_t, NodeId> results;
+        //The node of every level containing only cells outside the grid.
+        std::vector<NodeId> voidNodes;
+
+        RuleTable table;
+        Neighbourhood neighbourhood = Neighbourhood::Moore;
+        uint32_t m = 1u;
+        uint32_t countedType = 1u;
+        //Cells outside the grid are stored as voidType and counted as this type.
+        uint32_t fillType = voidType;
+        //The lowest level which is advanced. Its nodes are advanced cell by cell.
+        uint32_t baseLevel = 4u;
+        //Scratch memory of the base case.
+        BasicGrid<uint8_t> baseCells;
+        BasicGrid<uint8_t> nextBaseCells;
+
+        void Forget();
+        [[nodiscard]]
+        NodeId MakeLeaf(const Leaf& leaf);
+        [[nodiscard]]
+        NodeId MakeInner(NodeId nw, NodeId ne, NodeId sw, NodeId se);
+        [[nodiscard]]
+        NodeId VoidNode(uint32_t level);
+        //Builds the node of the given level whose north-west corner is the cell (x, y) of the grid.
+        [[nodiscard]]
+        NodeId Build(BasicGridView<uint8_t> cells, int64_t x, int64_t y, uint32_t level);
+        //Writes the cells of the node which are within the grid. Its north-west corner is at the cell (x, y) of the grid.
+        void Write(NodeId node, int64_t x, int64_t y, BasicGrid<uint8_t>& cells) const;
+        //Writes every cell of the node into a dense block with the given row stride.
+        void Expand(NodeId node, uint8_t* cells, size_t stride) const;
+        [[nodiscard]]
+        NodeId Collapse(const uint8_t* cells, size_t stride, uint32_t level);
+        //Number of generations a node of the given level can be advanced by a single call to Advance.
+        [[nodiscard]]
+        uint32_t MaxGenerations(uint32_t level) const;
+        [[nodiscard]]
+        NodeId Centre(NodeId node);
+        //The centre node one level down, advanced by at most MaxGenerations(level) generations.
+        [[nodiscard]]
+        NodeId Advance(NodeId node, uint32_t generations);
+        [[nodiscard]]
+        NodeId AdvanceBase(NodeId node, uint32_t generations);
+    public:
+        Quadtree() = default;
+        //Forgets every node and result, since they are only valid for one rule and boundary.
+        //Cells outside the grid have fillType and never change. Cell types must be below voidType.
+        void Reset(const OuterTotalisticRule& rule, const RuleTable& table, uint32_t fillType);
+        //Advances the live cells of the grid by the given number of generations. The halo is neither read nor written.
+        void Advance(BasicGrid<uint8_t>& cells, uint32_t generations);
+        //Number of distinct nodes stored, which shows how well the grids compress.
+        [[nodiscard]]
+        size_t GetNodeCount() const;
+    };
+}
+
+#endif
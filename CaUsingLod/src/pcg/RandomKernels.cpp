@@ -0,0 +1,257 @@
+#include "RandomKernels.h"
+#include <algorithm>
+#if PCG_X86
+#include <immintrin.h>
+#endif
+
+namespace pcg
+{
+    using MaskFunction = void(
+        const CellRandom& random, uint32_t y, uint32_t stream, uint32_t threshold, uint64_t* masks, uint32_t wordCount, uint32_t firstX);
+
+    //The constants of Philox4x32, as in philox4x32.
+    static constexpr uint32_t philoxMultiplier0 = 0xD2511F53u;
+    static constexpr uint32_t philoxMultiplier1 = 0xCD9E8D57u;
+    static constexpr uint32_t philoxWeyl0 = 0x9E3779B9u;
+    static constexpr uint32_t philoxWeyl1 = 0xBB67AE85u;
+
+    uint64_t percentThreshold(uint32_t percent)
+    {
+        //Percent holds if 1 + (value * 100 >> 32) <= percent, which is value * 100 < percent * 2^32.
+        uint64_t threshold = ((static_cast<uint64_t>(std::min(percent, 100u)) << 32u) + 99u) / 100u;
+        return threshold;
+    }
+
+    static void percentMasksScalar(
+        const CellRandom& random, uint32_t y, uint32_t stream, uint32_t threshold, uint64_t* masks, uint32_t wordCount, uint32_t firstX)
+    {
+        for (uint32_t word = 0u; word < wordCount; word++)
+        {
+            uint64_t bits = 0ull;
+            for (uint32_t i = 0u; i < 64u; i++)
+                bits |= static_cast<uint64_t>(random.Get(firstX + word * 64u + i, y, stream) < threshold) << i;
+            masks[word] = bits;
+        }
+    }
+
+#if PCG_X86
+    //The high and low halves of the products of every lane with a multiplier. Lanes are multiplied as 64-bit values,
+    //so the odd lanes are shifted down and multiplied separately.
+    PCG_TARGET("sse4.2")
+    static void multiplySse42(__m128i lanes, __m128i multiplier, __m128i& high, __m128i& low)
+    {
+        __m128i even = _mm_mul_epu32(lanes, multiplier);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(lanes, 32), multiplier);
+        low = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+        high = _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0xCC);
+    }
+
+    PCG_TARGET("sse4.2")
+    static __m128i philoxSse42(__m128i x, uint32_t y, uint32_t level, uint32_t stream, uint32_t key0, uint32_t key1)
+    {
+        __m128i counter0 = x;
+        __m128i counter1 = _mm_set1_epi32(static_cast<int>(y));
+        __m128i counter2 = _mm_set1_epi32(static_cast<int>(level));
+        __m128i counter3 = _mm_set1_epi32(static_cast<int>(stream));
+        __m128i multiplier0 = _mm_set1_epi32(static_cast<int>(philoxMultiplier0));
+        __m128i multiplier1 = _mm_set1_epi32(static_cast<int>(philoxMultiplier1));
+        for (uint32_t round = 0u; round < 10u; round++)
+        {
+            if (round > 0u)
+            {
+                key0 += philoxWeyl0;
+                key1 += philoxWeyl1;
+            }
+            __m128i high0, low0, high1, low1;
+            multiplySse42(counter0, multiplier0, high0, low0);
+            multiplySse42(counter2, multiplier1, high1, low1);
+            counter0 = _mm_xor_si128(_mm_xor_si128(high1, counter1), _mm_set1_epi32(static_cast<int>(key0)));
+            counter1 = low1;
+            counter2 = _mm_xor_si128(_mm_xor_si128(high0, counter3), _mm_set1_epi32(static_cast<int>(key1)));
+            counter3 = low0;
+        }
+        return counter0;
+    }
+
+    PCG_TARGET("sse4.2")
+    static void percentMasksSse42(
+        const CellRandom& random, uint32_t y, uint32_t stream, uint32_t threshold, uint64_t* masks, uint32_t wordCount, uint32_t firstX)
+    {
+        uint64_t seed = random.GetSeed();
+        uint32_t key0 = static_cast<uint32_t>(seed);
+        uint32_t key1 = static_cast<uint32_t>(seed >> 32u);
+        //There is no unsigned comparison, so both sides are offset into the signed range:
+        __m128i signBit = _mm_set1_epi32(static_cast<int>(0x80000000u));
+        __m128i offsetThreshold = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(threshold)), signBit);
+        __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+        for (uint32_t word = 0u; word < wordCount; word++)
+        {
+            uint64_t bits = 0ull;
+            for (uint32_t i = 0u; i < 64u; i += 4u)
+            {
+                __m128i x = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(firstX + word * 64u + i)), laneOffsets);
+                __m128i values = philoxSse42(x, y, random.GetLevel(), stream, key0, key1);
+                __m128i below = _mm_cmpgt_epi32(offsetThreshold, _mm_xor_si128(values, signBit));
+                bits |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(below))) << i;
+            }
+            masks[word] = bits;
+        }
+    }
+
+    PCG_TARGET("avx2")
+    static void multiplyAvx2(__m256i lanes, __m256i multiplier, __m256i& high, __m256i& low)
+    {
+        __m256i even = _mm256_mul_epu32(lanes, multiplier);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(lanes, 32), multiplier);
+        low = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+
+    PCG_TARGET("avx2")
+    static __m256i philoxAvx2(__m256i x, uint32_t y, uint32_t level, uint32_t stream, uint32_t key0, uint32_t key1)
+    {
+        __m256i counter0 = x;
+        __m256i counter1 = _mm256_set1_epi32(static_cast<int>(y));
+        __m256i counter2 = _mm256_set1_epi32(static_cast<int>(level));
+        __m256i counter3 = _mm256_set1_epi32(static_cast<int>(stream));
+        __m256i multiplier0 = _mm256_set1_epi32(static_cast<int>(philoxMultiplier0));
+        __m256i multiplier1 = _mm256_set1_epi32(static_cast<int>(philoxMultiplier1));
+        for (uint32_t round = 0u; round < 10u; round++)
+        {
+            if (round > 0u)
+            {
+                key0 += philoxWeyl0;
+                key1 += philoxWeyl1;
+            }
+            __m256i high0, low0, high1, low1;
+            multiplyAvx2(counter0, multiplier0, high0, low0);
+            multiplyAvx2(counter2, multiplier1, high1, low1);
+            counter0 = _mm256_xor_si256(_mm256_xor_si256(high1, counter1), _mm256_set1_epi32(static_cast<int>(key0)));
+            counter1 = low1;
+            counter2 = _mm256_xor_si256(_mm256_xor_si256(high0, counter3), _mm256_set1_epi32(static_cast<int>(key1)));
+            counter3 = low0;
+        }
+        return counter0;
+    }
+
+    PCG_TARGET("avx2")
+    static void percentMasksAvx2(
+        const CellRandom& random, uint32_t y, uint32_t stream, uint32_t threshold, uint64_t* masks, uint32_t wordCount, uint32_t firstX)
+    {
+        uint64_t seed = random.GetSeed();
+        uint32_t key0 = static_cast<uint32_t>(seed);
+        uint32_t key1 = static_cast<uint32_t>(seed >> 32u);
+        __m256i signBit = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+        __m256i offsetThreshold = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(threshold)), signBit);
+        __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (uint32_t word = 0u; word < wordCount; word++)
+        {
+            uint64_t bits = 0ull;
+            for (uint32_t i = 0u; i < 64u; i += 8u)
+            {
+                __m256i x = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(firstX + word * 64u + i)), laneOffsets);
+                __m256i values = philoxAvx2(x, y, random.GetLevel(), stream, key0, key1);
+                __m256i below = _mm256_cmpgt_epi32(offsetThreshold, _mm256_xor_si256(values, signBit));
+                bits |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(below))) << i;
+            }
+            masks[word] = bits;
+        }
+    }
+
+    PCG_TARGET("avx512f,avx512bw")
+    static void multiplyAvx512(__m512i lanes, __m512i multiplier, __m512i& high, __m512i& low)
+    {
+        __m512i even = _mm512_mul_epu32(lanes, multiplier);
+        __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(lanes, 32), multiplier);
+        low = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+        high = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+    }
+
+    PCG_TARGET("avx512f,avx512bw")
+    static __m512i philoxAvx512(__m512i x, uint32_t y, uint32_t level, uint32_t stream, uint32_t key0, uint32_t key1)
+    {
+        __m512i counter0 = x;
+        __m512i counter1 = _mm512_set1_epi32(static_cast<int>(y));
+        __m512i counter2 = _mm512_set1_epi32(static_cast<int>(level));
+        __m512i counter3 = _mm512_set1_epi32(static_cast<int>(stream));
+        __m512i multiplier0 = _mm512_set1_epi32(static_cast<int>(philoxMultiplier0));
+        __m512i multiplier1 = _mm512_set1_epi32(static_cast<int>(philoxMultiplier1));
+        for (uint32_t round = 0u; round < 10u; round++)
+        {
+            if (round > 0u)
+            {
+                key0 += philoxWeyl0;
+                key1 += philoxWeyl1;
+            }
+            __m512i high0, low0, high1, low1;
+            multiplyAvx512(counter0, multiplier0, high0, low0);
+            multiplyAvx512(counter2, multiplier1, high1, low1);
+            counter0 = _mm512_xor_si512(_mm512_xor_si512(high1, counter1), _mm512_set1_epi32(static_cast<int>(key0)));
+            counter1 = low1;
+            counter2 = _mm512_xor_si512(_mm512_xor_si512(high0, counter3), _mm512_set1_epi32(static_cast<int>(key1)));
+            counter3 = low0;
+        }
+        return counter0;
+    }
+
+    PCG_TARGET("avx512f,avx512bw")
+    static void percentMasksAvx512(
+        const CellRandom& random, uint32_t y, uint32_t stream, uint32_t threshold, uint64_t* masks, uint32_t wordCount, uint32_t firstX)
+    {
+        uint64_t seed = random.GetSeed();
+        uint32_t key0 = static_cast<uint32_t>(seed);
+        uint32_t key1 = static_cast<uint32_t>(seed >> 32u);
+        __m512i thresholds = _mm512_set1_epi32(static_cast<int>(threshold));
+        __m512i laneOffsets = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        for (uint32_t word = 0u; word < wordCount; word++)
+        {
+            uint64_t bits = 0ull;
+            for (uint32_t i = 0u; i < 64u; i += 16u)
+            {
+                __m512i x = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(firstX + word * 64u + i)), laneOffsets);
+                __m512i values = philoxAvx512(x, y, random.GetLevel(), stream, key0, key1);
+                bits |= static_cast<uint64_t>(_mm512_cmplt_epu32_mask(values, thresholds)) << i;
+            }
+            masks[word] = bits;
+        }
+    }
+#endif
+
+    void percentMasks(
+        const CellRandom& random,
+        uint32_t y,
+        uint32_t percent,
+        uint32_t stream,
+        uint64_t* masks,
+        uint32_t wordCount,
+        InstructionSet instructionSet,
+        uint32_t firstX)
+    {
+        //The chances of 0 and 100 percent need no random values:
+        uint64_t threshold = percentThreshold(percent);
+        if (threshold == 0ull || threshold > 0xFFFFFFFFull)
+        {
+            std::fill_n(masks, wordCount, threshold == 0ull ? 0ull : ~0ull);
+            return;
+        }
+
+        MaskFunction* maskFunction = percentMasksScalar;
+#if PCG_X86
+        switch (instructionSet)
+        {
+        case InstructionSet::Avx512:
+            maskFunction = percentMasksAvx512;
+            break;
+        case InstructionSet::Avx2:
+            maskFunction = percentMasksAvx2;
+            break;
+        case InstructionSet::Sse42:
+            maskFunction = percentMasksSse42;
+            break;
+        default:
+            break;
+        }
+#endif
+        maskFunction(random, y, stream, static_cast<uint32_t>(threshold), masks, wordCount, firstX);
+    }
+}
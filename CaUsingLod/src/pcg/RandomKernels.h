@@ -0,0 +1,34 @@
+/*
+* Kernels deciding many cells at once with the counter-based generator of CellRandom.
+* Every cell gets the same value as from CellRandom::Get, so the results do not depend on the kernel used.
+* The Philox rounds are run on a vector of cells at once, and the values are compared against a threshold,
+* which gives one bit per cell. SSE4.2, AVX2 and AVX-512 variants are picked at runtime.
+*/
+
+#ifndef PCG_RANDOMKERNELS_H
+#define PCG_RANDOMKERNELS_H
+
+#include <cstdint>
+#include "Random.h"
+#include "helpers/InstructionSet.h"
+
+namespace pcg
+{
+    //CellRandom::Percent holds exactly for the values below the returned threshold, which is 2^32 if it holds for every value.
+    [[nodiscard]]
+    uint64_t percentThreshold(uint32_t percent);
+
+    //Sets bit i % 64 of masks[i / 64] if random.Percent(firstX + i, y, percent, stream) holds, and clears it otherwise,
+    //for every i in [0, 64 * wordCount). The coordinates wrap around at 2^32.
+    void percentMasks(
+        const CellRandom& random,
+        uint32_t y,
+        uint32_t percent,
+        uint32_t stream,
+        uint64_t* masks,
+        uint32_t wordCount,
+        InstructionSet instructionSet,
+        uint32_t firstX = 0u);
+}
+
+#endif
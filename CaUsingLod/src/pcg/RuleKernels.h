@@ -0,0 +1,269 @@
+/*
+* Stepping kernels where the neighbourhood shape, the radius, the boundary policy and the rule are template parameters.
+* This lets the compiler unroll the neighbourhood loops and inline the rule, so no function is called per cell.
+* The radius is picked from the runtime value using a switch over the compiled radii.
+*/
+
+#ifndef PCG_RULEKERNELS_H
+#define PCG_RULEKERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+#include "Grid.h"
+#include "Rules.h"
+
+namespace pcg
+{
+    inline constexpr uint32_t maxCompiledRadius = 7u;
+
+    //Boundary policy where cells outside the grid are not counted.
+    struct OutsideIsNothing
+    {
+        static constexpr bool readsHalo = false;
+
+        //Clips the neighbourhood row [x0, x1] against a row of the given width. Returns false if nothing is left.
+        [[nodiscard]]
+        static bool ClipRow(int32_t& x0, int32_t& x1, int32_t width);
+        [[nodiscard]]
+        static bool ClipColumn(int32_t y, int32_t height);
+    };
+
+    //Boundary policy where cells outside the grid are read from its halo, which must be at least M cells wide.
+    //Every cell is counted as an interior cell, so no neighbourhood is clipped.
+    struct ReadHalo
+    {
+        static constexpr bool readsHalo = true;
+    };
+
+    //Rule functor turning the current type and the neighbour count into the next type using a compiled RuleTable.
+    class TableFunction
+    {
+    private:
+        const uint32_t* nextTypes;
+        uint32_t typeCount;
+        uint32_t rowLength;
+    public:
+        explicit TableFunction(const RuleTable& table);
+        [[nodiscard]]
+        uint32_t operator()(uint32_t cellType, uint32_t count) const;
+    };
+
+    //Counts the cells of countedType around a cell at least m cells away from every edge of the grid, or of its halo.
+    template<Neighbourhood N, uint32_t M, typename T>
+    [[nodiscard]]
+    uint32_t countInterior(const T* cell, size_t stride, T countedType);
+
+    //Counts the cells of countedType around a cell near the edges, clipping the neighbourhood by the boundary policy.
+    template<Neighbourhood N, uint32_t M, typename Boundary, typename T>
+    [[nodiscard]]
+    uint32_t countClipped(BasicGridView<T> cells, uint32_t x, uint32_t y, T countedType);
+
+    //Writes the rows [rowBegin, rowEnd) of the next generation into nextCells, which must have the size of cells.
+    //Only the columns [columnBegin, columnEnd) of the rows are written. countedType must be storable in T.
+    template<Neighbourhood N, uint32_t M, typename Boundary, typename Rule, typename T>
+    void stepRows(
+        BasicGridView<T> cells,
+        BasicGrid<T>& nextCells,
+        uint32_t countedType,
+        const Rule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        uint32_t columnBegin = 0u, uint32_t columnEnd = std::numeric_limits<uint32_t>::max());
+
+    //Calls stepRows with the radius m as a compile-time constant. Returns false if m is above maxCompiledRadius.
+    template<Neighbourhood N, typename Boundary, typename Rule, typename T>
+    [[nodiscard]]
+    bool stepRowsCompiled(
+        uint32_t m,
+        BasicGridView<T> cells,
+        BasicGrid<T>& nextCells,
+        uint32_t countedType,
+        const Rule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        uint32_t columnBegin = 0u, uint32_t columnEnd = std::numeric_limits<uint32_t>::max());
+
+    template<typename Boundary, typename Rule, typename T>
+    [[nodiscard]]
+    bool stepRowsCompiled(
+        Neighbourhood neighbourhood,
+        uint32_t m,
+        BasicGridView<T> cells,
+        BasicGrid<T>& nextCells,
+        uint32_t countedType,
+        const Rule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        uint32_t columnBegin = 0u, uint32_t columnEnd = std::numeric_limits<uint32_t>::max());
+
+    inline bool OutsideIsNothing::ClipRow(int32_t& x0, int32_t& x1, int32_t width)
+    {
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, width - 1);
+        return x0 <= x1;
+    }
+
+    inline bool OutsideIsNothing::ClipColumn(int32_t y, int32_t height)
+    {
+        return y >= 0 && y < height;
+    }
+
+    inline TableFunction::TableFunction(const RuleTable& table)
+        : nextTypes(table.Row(0u)), typeCount(table.GetTypeCount()), rowLength(table.GetMaxCount() + 1u) { }
+
+    inline uint32_t TableFunction::operator()(uint32_t cellType, uint32_t count) const
+    {
+        uint32_t nextType = nextTypes[std::min(cellType, typeCount) * rowLength + count];
+        return nextType == RuleTable::keepType ? cellType : nextType;
+    }
+
+    template<Neighbourhood N, uint32_t M, typename T>
+    inline uint32_t countInterior(const T* cell, size_t stride, T countedType)
+    {
+        constexpr int32_t m = static_cast<int32_t>(M);
+        uint32_t count = 0u;
+        for (int32_t dy = -m; dy <= m; dy++)
+        {
+            const T* row = cell + dy * static_cast<ptrdiff_t>(stride);
+            int32_t r = N == Neighbourhood::Moore ? m : m - std::abs(dy);
+            for (int32_t dx = -r; dx <= r; dx++)
+                count += row[dx] == countedType;
+        }
+        return count;
+    }
+
+    template<Neighbourhood N, uint32_t M, typename Boundary, typename T>
+    inline uint32_t countClipped(BasicGridView<T> cells, uint32_t x, uint32_t y, T countedType)
+    {
+        constexpr int32_t m = static_cast<int32_t>(M);
+        int32_t width = static_cast<int32_t>(cells.GetWidth());
+        int32_t height = static_cast<int32_t>(cells.GetHeight());
+        uint32_t count = 0u;
+        for (int32_t dy = -m; dy <= m; dy++)
+        {
+            int32_t y1 = static_cast<int32_t>(y) + dy;
+            if (!Boundary::ClipColumn(y1, height))
+                continue;
+            int32_t r = N == Neighbourhood::Moore ? m : m - std::abs(dy);
+            int32_t x0 = static_cast<int32_t>(x) - r;
+            int32_t x1 = static_cast<int32_t>(x) + r;
+            if (!Boundary::ClipRow(x0, x1, width))
+                continue;
+            const T* row = cells.Row(y1);
+            for (; x0 <= x1; x0++)
+                count += row[x0] == countedType;
+        }
+        return count;
+    }
+
+    template<Neighbourhood N, uint32_t M, typename Boundary, typename Rule, typename T>
+    inline void stepRows(
+        BasicGridView<T> cells,
+        BasicGrid<T>& nextCells,
+        uint32_t countedType,
+        const Rule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        uint32_t columnBegin, uint32_t columnEnd)
+    {
+        uint32_t width = cells.GetWidth();
+        columnEnd = std::min(columnEnd, width);
+        size_t stride = cells.GetStride();
+        T counted = static_cast<T>(countedType);
+
+        if constexpr (Boundary::readsHalo)
+        {
+            for (uint32_t y = rowBegin; y < rowEnd; y++)
+            {
+                const T* row = cells.Row(y);
+                T* nextRow = nextCells.Row(y);
+                for (uint32_t x = columnBegin; x < columnEnd; x++)
+                    nextRow[x] = static_cast<T>(rule(row[x], countInterior<N, M>(row + x, stride, counted)));
+            }
+        }
+        else
+        {
+            uint32_t height = cells.GetHeight();
+            //Columns [interiorBegin, interiorEnd) are at least M cells away from the left and right edges.
+            uint32_t interiorBegin = std::clamp(M, columnBegin, std::max(columnBegin, columnEnd));
+            uint32_t interiorEnd = std::clamp(width > M ? width - M : 0u, interiorBegin, std::max(interiorBegin, columnEnd));
+            for (uint32_t y = rowBegin; y < rowEnd; y++)
+            {
+                const T* row = cells.Row(y);
+                T* nextRow = nextCells.Row(y);
+                if (y < M || y + M >= height)
+                {
+                    for (uint32_t x = columnBegin; x < columnEnd; x++)
+                        nextRow[x] = static_cast<T>(rule(row[x], countClipped<N, M, Boundary>(cells, x, y, counted)));
+                    continue;
+                }
+                for (uint32_t x = columnBegin; x < interiorBegin; x++)
+                    nextRow[x] = static_cast<T>(rule(row[x], countClipped<N, M, Boundary>(cells, x, y, counted)));
+                for (uint32_t x = interiorBegin; x < interiorEnd; x++)
+                    nextRow[x] = static_cast<T>(rule(row[x], countInterior<N, M>(row + x, stride, counted)));
+                for (uint32_t x = interiorEnd; x < columnEnd; x++)
+                    nextRow[x] = static_cast<T>(rule(row[x], countClipped<N, M, Boundary>(cells, x, y, counted)));
+            }
+        }
+    }
+
+    template<Neighbourhood N, typename Boundary, typename Rule, typename T>
+    inline bool stepRowsCompiled(
+        uint32_t m,
+        BasicGridView<T> cells,
+        BasicGrid<T>& nextCells,
+        uint32_t countedType,
+        const Rule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        uint32_t columnBegin, uint32_t columnEnd)
+    {
+        switch (m)
+        {
+        case 0u:
+            stepRows<N, 0u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        case 1u:
+            stepRows<N, 1u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        case 2u:
+            stepRows<N, 2u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        case 3u:
+            stepRows<N, 3u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        case 4u:
+            stepRows<N, 4u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        case 5u:
+            stepRows<N, 5u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        case 6u:
+            stepRows<N, 6u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        case 7u:
+            stepRows<N, 7u, Boundary>(cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    template<typename Boundary, typename Rule, typename T>
+    inline bool stepRowsCompiled(
+        Neighbourhood neighbourhood,
+        uint32_t m,
+        BasicGridView<T> cells,
+        BasicGrid<T>& nextCells,
+        uint32_t countedType,
+        const Rule& rule,
+        uint32_t rowBegin, uint32_t rowEnd,
+        uint32_t columnBegin, uint32_t columnEnd)
+    {
+        if (neighbourhood == Neighbourhood::Moore)
+            return stepRowsCompiled<Neighbourhood::Moore, Boundary>(
+                m, cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+        return stepRowsCompiled<Neighbourhood::VonNeumann, Boundary>(
+            m, cells, nextCells, countedType, rule, rowBegin, rowEnd, columnBegin, columnEnd);
+    }
+}
+
+#endif
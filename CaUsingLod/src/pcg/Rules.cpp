@@ -0,0 +1,138 @@
+#include "Rules.h"
+#include <algorithm>
+
+namespace pcg
+{
+    uint32_t neighbourhoodSize(Neighbourhood neighbourhood, uint32_t m)
+    {
+        if (neighbourhood == Neighbourhood::Moore)
+            return (2u * m + 1u) * (2u * m + 1u);
+        return 2u * m * (m + 1u) + 1u;
+    }
+
+    RuleTable::RuleTable(uint32_t typeCount, uint32_t maxCount)
+        : nextTypes(static_cast<size_t>(typeCount + 1u) * (maxCount + 1u), keepType),
+        typeCount(typeCount), maxCount(maxCount) { }
+
+    void RuleTable::Set(uint32_t row, uint32_t count, uint32_t nextType)
+    {
+        nextTypes[static_cast<size_t>(row) * (maxCount + 1u) + count] = nextType;
+    }
+
+    uint32_t RuleTable::Get(uint32_t cellType, uint32_t count) const
+    {
+        uint32_t nextType = Row(cellType)[count];
+        return nextType == keepType ? cellType : nextType;
+    }
+
+    const uint32_t* RuleTable::Row(uint32_t cellType) const
+    {
+        return nextTypes.data() + static_cast<size_t>(std::min(cellType, typeCount)) * (maxCount + 1u);
+    }
+
+    uint32_t RuleTable::GetTypeCount() const
+    {
+        return typeCount;
+    }
+
+    uint32_t RuleTable::GetMaxCount() const
+    {
+        return maxCount;
+    }
+
+    std::optional<RuleTable::Interval> RuleTable::RowInterval(uint32_t cellType) const
+    {
+        const uint32_t* row = Row(cellType);
+        auto resolve = [cellType](uint32_t nextType) { return nextType == keepType ? cellType : nextType; };
+
+        //The interval starts at the first change of the row and ends at the second:
+        uint32_t outside = resolve(row[0]);
+        uint32_t count = 1u;
+        while (count <= maxCount && resolve(row[count]) == outside)
+            count++;
+        if (count > maxCount)
+            return Interval{ 0u, maxCount, outside, outside };
+        uint32_t minCount = count;
+        uint32_t inside = resolve(row[count]);
+        while (count <= maxCount && resolve(row[count]) == inside)
+            count++;
+        uint32_t intervalEnd = count - 1u;
+        while (count <= maxCount && resolve(row[count]) == outside)
+            count++;
+        if (count <= maxCount)
+            return std::nullopt;
+        return Interval{ minCount, intervalEnd, inside, outside };
+    }
+
+    bool RuleTable::HigherTypesKept() const
+    {
+        const uint32_t* row = Row(typeCount);
+        return std::all_of(row, row + maxCount + 1u, [](uint32_t nextType) { return nextType == keepType; });
+    }
+
+    uint32_t RuleTable::MaxNextType() const
+    {
+        uint32_t maxType = 0u;
+        for (uint32_t nextType : nextTypes)
+            if (nextType != keepType)
+                maxType = std::max(maxType, nextType);
+        return maxType;
+    }
+
+    OuterTotalisticRule OuterTotalisticRule::Threshold(const ThresholdRule& rule)
+    {
+        OuterTotalisticRule result;
+        result.m = rule.m;
+        result.neighbourhood = rule.neighbourhood;
+        result.countedType = rule.countedType;
+        result.transitions =
+        {
+            { .minCount = rule.t, .nextType = rule.typeAtThreshold },
+            { .nextType = rule.typeBelowThreshold }
+        };
+        return result;
+    }
+
+    OuterTotalisticRule OuterTotalisticRule::BirthSurvival(
+        uint32_t m,
+        std::initializer_list<uint32_t> birthCounts,
+        std::initializer_list<uint32_t> survivalCounts,
+        uint32_t aliveType,
+        uint32_t deadType,
+        Neighbourhood neighbourhood)
+    {
+        OuterTotalisticRule result;
+        result.m = m;
+        result.neighbourhood = neighbourhood;
+        result.countedType = aliveType;
+        //The counts of the rule include the cell itself, which only matters for living cells.
+        for (uint32_t count : birthCounts)
+            result.transitions.push_back({ deadType, count, count, aliveType });
+        for (uint32_t count : survivalCounts)
+            result.transitions.push_back({ aliveType, count + 1u, count + 1u, aliveType });
+        result.transitions.push_back({ .cellType = aliveType, .nextType = deadType });
+        return result;
+    }
+
+    RuleTable OuterTotalisticRule::Compile() const
+    {
+        uint32_t typeCount = 0u;
+        for (const auto& transition : transitions)
+            if (transition.cellType != anyType)
+                typeCount = std::max(typeCount, transition.cellType + 1u);
+        uint32_t maxCount = neighbourhoodSize(neighbourhood, m);
+
+        //Transitions are applied in reverse, so the first matching transition is the one left in the table.
+        RuleTable table(typeCount, maxCount);
+        for (auto transition = transitions.rbegin(); transition != transitions.rend(); transition++)
+        {
+            uint32_t firstRow = transition->cellType == anyType ? 0u : transition->cellType;
+            uint32_t lastRow = transition->cellType == anyType ? typeCount : transition->cellType;
+            uint32_t lastCount = std::min(transition->maxCount, maxCount);
+            for (uint32_t row = firstRow; row <= lastRow; row++)
+                for (uint32_t count = transition->minCount; count <= lastCount; count++)
+                    table.Set(row, count, transition->nextType);
+        }
+        return table;
+    }
+}
@@ -0,0 +1,145 @@
+/*
+* Declarative descriptions of cellular automata rules.
+* Unlike rules given as functions, these can be inspected by CellularAutomata, which allows it to pick specialised stepping kernels.
+* Outer totalistic rules are compiled into a RuleTable, which gives the next type of a cell from its current type and its neighbour count.
+*/
+
+#ifndef PCG_RULES_H
+#define PCG_RULES_H
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <optional>
+#include <initializer_list>
+#include <array>
+#include <functional>
+
+namespace pcg
+{
+    enum class Neighbourhood
+    {
+        //The square of cells within a Chebyshev distance of m.
+        Moore,
+        //The diamond of cells within a Manhattan distance of m.
+        VonNeumann
+    };
+
+    //Number of cells in the neighbourhood of radius m, including the cell itself.
+    [[nodiscard]]
+    uint32_t neighbourhoodSize(Neighbourhood neighbourhood, uint32_t m);
+
+    //A cell becomes typeAtThreshold if at least t cells of countedType are in its neighbourhood, otherwise it becomes typeBelowThreshold.
+    //The neighbourhood has radius m and includes the cell itself. Cells outside the grid are not counted.
+    struct ThresholdRule
+    {
+        uint32_t m = 1u;
+        uint32_t t = 5u;
+        uint32_t countedType = 1u;
+        uint32_t typeAtThreshold = 1u;
+        uint32_t typeBelowThreshold = 0u;
+        Neighbourhood neighbourhood = Neighbourhood::Moore;
+    };
+
+    //A rule where the next type of a cell depends on the number of cells of every type in its Moore neighbourhood.
+    //The counts of the types 0 to typeCount - 1 are computed for every cell in one sweep, including the cell itself.
+    //Cells of higher types are not counted, and neither are cells outside the grid unless the boundary gives them a counted type.
+    struct HistogramRule
+    {
+        static constexpr uint32_t maxTypeCount = 16u;
+        //The counts of a neighbourhood. Only the first typeCount entries are used.
+        using Counts = std::array<uint16_t, maxTypeCount>;
+
+        uint32_t m = 1u;
+        uint32_t typeCount = 2u;
+        //Gives the next type of the cell (x, y) from its type and counts[t], the number of cells of type t.
+        //Called from several threads at once, unless the thread count is set to 1.
+        std::function<uint32_t(uint32_t cellType, const uint16_t* counts, uint32_t x, uint32_t y)> next;
+    };
+
+    //The next type of every combination of current type and neighbour count.
+    //Types from 0 to typeCount - 1 have their own rows. All higher types share one more row.
+    class RuleTable
+    {
+    public:
+        //Entry telling that the cell keeps its current type.
+        static constexpr uint32_t keepType = std::numeric_limits<uint32_t>::max();
+
+        //A row of the table given as a range of counts. Counts within the range give typeInside, other counts give typeOutside.
+        struct Interval
+        {
+            uint32_t minCount;
+            uint32_t maxCount;
+            uint32_t typeInside;
+            uint32_t typeOutside;
+        };
+    private:
+        std::vector<uint32_t> nextTypes;
+        uint32_t typeCount = 0u;
+        uint32_t maxCount = 0u;
+    public:
+        RuleTable() = default;
+        //Every cell keeps its type until the entries are set.
+        RuleTable(uint32_t typeCount, uint32_t maxCount);
+        //Sets the entry of a row. Row typeCount is the row shared by all higher types.
+        void Set(uint32_t row, uint32_t count, uint32_t nextType);
+        [[nodiscard]]
+        uint32_t Get(uint32_t cellType, uint32_t count) const;
+        //The row used by cellType. Entries may be keepType.
+        [[nodiscard]]
+        const uint32_t* Row(uint32_t cellType) const;
+        [[nodiscard]]
+        uint32_t GetTypeCount() const;
+        [[nodiscard]]
+        uint32_t GetMaxCount() const;
+        //Describes the row of cellType as an interval, with keepType replaced by cellType.
+        //Returns nothing if the row has more than two pieces.
+        [[nodiscard]]
+        std::optional<Interval> RowInterval(uint32_t cellType) const;
+        //True if every entry of the row shared by the higher types is keepType.
+        [[nodiscard]]
+        bool HigherTypesKept() const;
+        //The largest type produced by the table, ignoring kept types.
+        [[nodiscard]]
+        uint32_t MaxNextType() const;
+    };
+
+    //A rule where the next type of a cell only depends on its current type and the number of cells of countedType in its neighbourhood.
+    //Every transition turns cells of cellType with a count in [minCount, maxCount] into nextType. The first matching transition is used.
+    //Cells without a matching transition keep their type.
+    struct OuterTotalisticRule
+    {
+        //Transitions with this cell type apply to cells of every type.
+        static constexpr uint32_t anyType = std::numeric_limits<uint32_t>::max();
+
+        struct Transition
+        {
+            uint32_t cellType = anyType;
+            uint32_t minCount = 0u;
+            uint32_t maxCount = std::numeric_limits<uint32_t>::max();
+            uint32_t nextType = 0u;
+        };
+
+        uint32_t m = 1u;
+        Neighbourhood neighbourhood = Neighbourhood::Moore;
+        uint32_t countedType = 1u;
+        std::vector<Transition> transitions;
+
+        [[nodiscard]]
+        static OuterTotalisticRule Threshold(const ThresholdRule& rule);
+        //Life-like rules. The counts are given without the cell itself, as in the usual B/S notation.
+        //Other cells of aliveType die and other cells of deadType stay dead.
+        [[nodiscard]]
+        static OuterTotalisticRule BirthSurvival(
+            uint32_t m,
+            std::initializer_list<uint32_t> birthCounts,
+            std::initializer_list<uint32_t> survivalCounts,
+            uint32_t aliveType = 1u,
+            uint32_t deadType = 0u,
+            Neighbourhood neighbourhood = Neighbourhood::Moore);
+        [[nodiscard]]
+        RuleTable Compile() const;
+    };
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include "SlicedGrid.h"
+#include "RandomKernels.h"
+#include <bit>
+#include <array>
+#include <algorithm>
+
+namespace pcg
+{
+    void SlicedGrid::Resize(uint32_t width, uint32_t height, uint32_t halo, uint32_t sliceCount)
+    {
+        words.Resize(width, height, halo);
+        this->sliceCount = std::min(sliceCount, maxSliceCount);
+    }
+
+    //Transposes a matrix of 64 * 64 bits, where bit j of rows[i] is the element in row i and column j.
+    static void transpose(std::array<uint64_t, 64>& rows)
+    {
+        uint64_t mask = 0x00000000FFFFFFFFull;
+        for (uint32_t j = 32u; j != 0u; j >>= 1u, mask ^= mask << j)
+        {
+            for (uint32_t k = 0u; k < 64u; k = ((k | j) + 1u) & ~j)
+            {
+                uint64_t swapped = ((rows[k] >> j) ^ rows[k | j]) & mask;
+                rows[k] ^= swapped << j;
+                rows[k | j] ^= swapped;
+            }
+        }
+    }
+
+    //Computes the random bits of every grid 64 cells at a time, one row of cells per grid,
+    //and transposes each block of 64 * 64 bits into 64 sliced cells. The cells are either set to the bits or flipped by them.
+    static void randomRows(
+        SlicedGrid& grid,
+        const std::vector<CellRandom>& randoms, uint32_t percent,
+        uint32_t rowBegin, uint32_t rowEnd,
+        InstructionSet instructionSet,
+        bool flip)
+    {
+        uint32_t width = grid.GetWidth();
+        uint32_t wordsPerRow = (width + 63u) / 64u;
+        uint32_t randomCount = std::min(grid.GetSliceCount(), static_cast<uint32_t>(randoms.size()));
+        std::vector<uint64_t> masks(static_cast<size_t>(randomCount) * wordsPerRow);
+        std::array<uint64_t, 64> block;
+        for (uint32_t y = rowBegin; y < rowEnd; y++)
+        {
+            for (uint32_t k = 0u; k < randomCount; k++)
+                percentMasks(randoms[k], y, percent, 0u, &masks[k * wordsPerRow], wordsPerRow, instructionSet);
+            uint64_t* row = grid.Row(y);
+            for (uint32_t word = 0u; word < wordsPerRow; word++)
+            {
+                for (uint32_t k = 0u; k < 64u; k++)
+                    block[k] = k < randomCount ? masks[k * wordsPerRow + word] : 0ull;
+                transpose(block);
+                uint32_t x0 = word * 64u;
+                uint32_t cellCount = std::min(64u, width - x0);
+                for (uint32_t i = 0u; i < cellCount; i++)
+                    row[x0 + i] = flip ? row[x0 + i] ^ block[i] : block[i];
+            }
+        }
+    }
+
+    void SlicedGrid::InitializeRandom(
+        const std::vector<CellRandom>& randoms, uint32_t percent,
+        uint32_t rowBegin, uint32_t rowEnd,
+        InstructionSet instructionSet)
+    {
+        randomRows(*this, randoms, percent, rowBegin, rowEnd, instructionSet, false);
+    }
+
+    void SlicedGrid::FlipRandom(
+        const std::vector<CellRandom>& randoms, uint32_t percent,
+        uint32_t rowBegin, uint32_t rowEnd,
+        InstructionSet instructionSet)
+    {
+        randomRows(*this, randoms, percent, rowBegin, rowEnd, instructionSet, true);
+    }
+
+    void SlicedGrid::Scale(const SlicedGrid& cells, uint32_t multiplier)
+    {
+        uint32_t width = cells.GetWidth();
+        uint32_t height = cells.GetHeight();
+        Resize(width * multiplier, height * multiplier, cells.GetHalo(), cells.sliceCount);
+        for (uint32_t y = 0u; y < height * multiplier; y++)
+        {
+            const uint64_t* row = cells.Row(y / multiplier);
+            uint64_t* scaledRow = Row(y);
+            for (uint32_t x = 0u; x < width; x++)
+                std::fill_n(scaledRow + x * multiplier, multiplier, row[x]);
+        }
+    }
+
+    void SlicedGrid::Step(
+        const SlicedGrid& cells,
+        uint32_t m,
+        const BitTransition& setBits,
+        const BitTransition& clearedBits,
+        uint32_t rowBegin, uint32_t rowEnd,
+        std::vector<uint64_t>& columnCounts)
+    {
+        uint32_t width = GetWidth();
+        if (width == 0u)
+            return;
+        uint32_t side = 2u * m + 1u;
+        uint32_t columnPlanes = std::bit_width(side);
+        uint32_t totalPlanes = std::bit_width(side * side);
+        //The counters of the columns from -m to width + m - 1, with the planes of a column next to each other:
+        uint32_t columnCount = width + 2u * m;
+        columnCounts.resize(static_cast<size_t>(columnPlanes) * columnCount);
+        //Most rules treat both bit values the same, which saves evaluating the transitions twice.
+        bool sameTransitions = setBits == clearedBits;
+        int32_t sm = static_cast<int32_t>(m);
+
+        for (uint32_t y = rowBegin; y < rowEnd; y++)
+        {
+            //Vertical pass: count the set bits of each column within the neighbourhood rows, which may lie in the halo.
+            std::fill(columnCounts.begin(), columnCounts.end(), 0ull);
+            for (int32_t dy = -sm; dy <= sm; dy++)
+            {
+                const uint64_t* row = cells.Row(static_cast<int32_t>(y) + dy) - m;
+                for (uint32_t column = 0u; column < columnCount; column++)
+                    addBits(&columnCounts[column * columnPlanes], columnPlanes, row[column]);
+            }
+
+            //Horizontal pass: add the column counts of the neighbouring columns and apply the transitions.
+            const uint64_t* row = cells.Row(y);
+            uint64_t* nextRow = Row(y);
+            for (uint32_t x = 0u; x < width; x++)
+            {
+                uint64_t total[maxCounterPlanes]{};
+                for (uint32_t column = x; column < x + side; column++)
+                    addCounter(total, totalPlanes, &columnCounts[column * columnPlanes], columnPlanes);
+                if (sameTransitions)
+                    nextRow[x] = applyTransition(total, totalPlanes, setBits);
+                else
+                    nextRow[x] =
+                        (row[x] & applyTransition(total, totalPlanes, setBits)) |
+                        (~row[x] & applyTransition(total, totalPlanes, clearedBits));
+            }
+        }
+    }
+
+    void SlicedGrid::UpdateHalo(const Boundary& boundary, bool fillBit)
+    {
+        Boundary slicedBoundary = boundary;
+        slicedBoundary.fillType = 0u;
+        words.UpdateHalo(slicedBoundary);
+        if (boundary.policy != BoundaryPolicy::Fill || !fillBit)
+            return;
+
+        //Under the fill policy every cell of the halo is outside the grid:
+        int32_t halo = static_cast<int32_t>(GetHalo());
+        int32_t width = static_cast<int32_t>(GetWidth());
+        int32_t height = static_cast<int32_t>(GetHeight());
+        for (int32_t y = -halo; y < height + halo; y++)
+        {
+            uint64_t* row = Row(y);
+            if (y < 0 || y >= height)
+                std::fill(row - halo, row + width + halo, ~0ull);
+            else
+            {
+                std::fill(row - halo, row, ~0ull);
+                std::fill(row + width, row + width + halo, ~0ull);
+            }
+        }
+    }
+
+    void SlicedGrid::Invert()
+    {
+        for (uint32_t y = 0u; y < GetHeight(); y++)
+        {
+            uint64_t* row = Row(y);
+            for (uint32_t x = 0u; x < GetWidth(); x++)
+                row[x] = ~row[x];
+        }
+    }
+
+    uint64_t* SlicedGrid::Row(int32_t y)
+    {
+        return words.Row(y);
+    }
+
+    const uint64_t* SlicedGrid::Row(int32_t y) const
+    {
+        return words.Row(y);
+    }
+
+    uint32_t SlicedGrid::GetWidth() const
+    {
+        return words.GetWidth();
+    }
+
+    uint32_t SlicedGrid::GetHeight() const
+    {
+        return words.GetHeight();
+    }
+
+    uint32_t SlicedGrid::GetHalo() const
+    {
+        return words.GetHalo();
+    }
+
+    uint32_t SlicedGrid::GetSliceCount() const
+    {
+        return sliceCount;
+    }
+}
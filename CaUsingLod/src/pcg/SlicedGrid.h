@@ -0,0 +1,92 @@
+/*
+* A batch of up to 64 grids with two cell types and the same size, stored bitsliced.
+* Every cell is a 64-bit word where bit k belongs to grid k, so every word operation works on the same cell of all grids.
+* Small grids do not fill the vector width of a core on their own, but a batch of them steps with pure bitwise logic
+* and no shuffling between words. Neighbour counts are computed with the bit plane counters of BitCounters.h.
+* The words are stored in a BasicGrid, whose halo lets the neighbourhoods follow any boundary policy.
+*/
+
+#ifndef PCG_SLICEDGRID_H
+#define PCG_SLICEDGRID_H
+
+#include <vector>
+#include <cstdint>
+#include "Grid.h"
+#include "BitCounters.h"
+#include "Random.h"
+#include "helpers/InstructionSet.h"
+
+namespace pcg
+{
+    class SlicedGrid
+    {
+    private:
+        BasicGrid<uint64_t> words;
+        uint32_t sliceCount = 0u;
+    public:
+        static constexpr uint32_t maxSliceCount = 64u;
+        static constexpr uint32_t maxRadius = 63u;
+
+        //The bits of grids from sliceCount on are left undefined.
+        void Resize(uint32_t width, uint32_t height, uint32_t halo, uint32_t sliceCount);
+        //Bit k of cell (x, y) is set if randoms[k].Percent(x, y, percent) holds, for the first sliceCount generators.
+        //Only the rows [rowBegin, rowEnd) are written, so bands of rows can be initialized concurrently.
+        void InitializeRandom(
+            const std::vector<CellRandom>& randoms, uint32_t percent,
+            uint32_t rowBegin, uint32_t rowEnd,
+            InstructionSet instructionSet);
+        //Flips bit k of cell (x, y) if randoms[k].Percent(x, y, percent) holds.
+        void FlipRandom(
+            const std::vector<CellRandom>& randoms, uint32_t percent,
+            uint32_t rowBegin, uint32_t rowEnd,
+            InstructionSet instructionSet);
+        //Writes cells scaled by the multiplier into this grid. Every cell becomes a block of multiplier * multiplier cells.
+        void Scale(const SlicedGrid& cells, uint32_t multiplier);
+        //Writes the rows [rowBegin, rowEnd) of the next generation of every grid. This grid must already have the size of cells.
+        //The counts are the numbers of set bits within the Moore neighbourhood of radius m, which must fit in the halo of cells.
+        //Bands of rows can be stepped concurrently as long as each has its own columnCounts.
+        void Step(
+            const SlicedGrid& cells,
+            uint32_t m,
+            const BitTransition& setBits,
+            const BitTransition& clearedBits,
+            uint32_t rowBegin, uint32_t rowEnd,
+            std::vector<uint64_t>& columnCounts);
+        //Fills the halo following the boundary. Under BoundaryPolicy::Fill the bits outside every grid are fillBit.
+        void UpdateHalo(const Boundary& boundary, bool fillBit);
+        //Flips the bits of every grid.
+        void Invert();
+        //Writes grid k into cells, with oneType for set bits and zeroType for cleared bits. The halo of cells is not updated.
+        template<typename T>
+        void Unpack(uint32_t k, BasicGrid<T>& cells, uint32_t oneType, uint32_t zeroType) const;
+        [[nodiscard]]
+        uint64_t* Row(int32_t y);
+        [[nodiscard]]
+        const uint64_t* Row(int32_t y) const;
+        [[nodiscard]]
+        uint32_t GetWidth() const;
+        [[nodiscard]]
+        uint32_t GetHeight() const;
+        [[nodiscard]]
+        uint32_t GetHalo() const;
+        [[nodiscard]]
+        uint32_t GetSliceCount() const;
+    };
+
+    template<typename T>
+    inline void SlicedGrid::Unpack(uint32_t k, BasicGrid<T>& cells, uint32_t oneType, uint32_t zeroType) const
+    {
+        uint32_t width = GetWidth();
+        uint32_t height = GetHeight();
+        cells.Resize(width, height);
+        for (uint32_t y = 0u; y < height; y++)
+        {
+            T* row = cells.Row(y);
+            const uint64_t* slicedRow = Row(y);
+            for (uint32_t x = 0u; x < width; x++)
+                row[x] = static_cast<T>((slicedRow[x] >> k) & 1ull ? oneType : zeroType);
+        }
+    }
+}
+
+#endif
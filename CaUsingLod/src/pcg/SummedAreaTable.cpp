@@ -0,0 +1,17 @@
+#include "SummedAreaTable.h"
+
+namespace pcg
+{
+    uint32_t SummedAreaTable::Count(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const
+    {
+        //The rectangle is inclusive. Row and column 0 of the table are zero, so no bounds checks are needed.
+        size_t stride = static_cast<size_t>(width) + 1ull;
+        size_t top = y0 * stride;
+        size_t bottom = (y1 + 1ull) * stride;
+        return
+            sums[bottom + x1 + 1u] -
+            sums[top + x1 + 1u] -
+            sums[bottom + x0] +
+            sums[top + x0];
+    }
+}
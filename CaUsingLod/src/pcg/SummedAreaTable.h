@@ -0,0 +1,54 @@
+/*
+* A summed-area table counting the cells of one type in a grid.
+* After the table has been built, the number of matching cells in any rectangle is found using four lookups.
+* This makes neighbourhood counts independent of the neighbourhood radius.
+*/
+
+#ifndef PCG_SUMMEDAREATABLE_H
+#define PCG_SUMMEDAREATABLE_H
+
+#include <vector>
+#include <cstdint>
+#include "Grid.h"
+
+namespace pcg
+{
+    class SummedAreaTable
+    {
+    private:
+        std::vector<uint32_t> sums;
+        uint32_t width = 0u;
+        uint32_t height = 0u;
+    public:
+        template<typename T>
+        void Build(BasicGridView<T> cells, uint32_t cellType);
+        [[nodiscard]]
+        uint32_t Count(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const;
+    };
+
+    template<typename T>
+    inline void SummedAreaTable::Build(BasicGridView<T> cells, uint32_t cellType)
+    {
+        width = cells.GetWidth();
+        height = cells.GetHeight();
+        size_t stride = static_cast<size_t>(width) + 1ull;
+        sums.resize(stride * (static_cast<size_t>(height) + 1ull));
+        std::fill(sums.begin(), sums.begin() + stride, 0u);
+
+        for (uint32_t y = 0u; y < height; y++)
+        {
+            const T* row = cells.Row(y);
+            const uint32_t* previousSums = &sums[y * stride];
+            uint32_t* rowSums = &sums[(y + 1ull) * stride];
+            uint32_t rowSum = 0u;
+            rowSums[0] = 0u;
+            for (uint32_t x = 0u; x < width; x++)
+            {
+                rowSum += row[x] == cellType;
+                rowSums[x + 1u] = previousSums[x + 1u] + rowSum;
+            }
+        }
+    }
+}
+
+#endif
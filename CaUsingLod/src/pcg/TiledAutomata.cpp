@@ -0,0 +1,306 @@
+#include "TiledAutomata.h"
+#include <algorithm>
+
+namespace pcg
+{
+    //Remainder of a division by a positive divisor, also for negative numerators:
+    static int64_t floorModulo(int64_t numerator, int64_t divisor)
+    {
+        return ((numerator % divisor) + divisor) % divisor;
+    }
+
+    TiledAutomata::TiledAutomata(CellularAutomata& ca)
+        : ca(ca) { }
+
+    void TiledAutomata::ForEachTile(
+        const TiledGrid* source, TiledGrid& destination,
+        uint32_t multiplier, uint32_t reach,
+        const std::function<void(uint32_t, uint32_t, uint32_t, uint32_t)>& visit)
+    {
+        uint32_t tileSize = destination.GetTileSize();
+        for (uint32_t tileY = 0u; tileY < destination.GetTileCountY(); tileY++)
+        {
+            uint32_t y0 = tileY * tileSize;
+            uint32_t y1 = std::min(y0 + tileSize, destination.GetHeight());
+            for (uint32_t tileX = 0u; tileX < destination.GetTileCountX(); tileX++)
+            {
+                uint32_t x0 = tileX * tileSize;
+                visit(x0, y0, std::min(x0 + tileSize, destination.GetWidth()), y1);
+            }
+            destination.Release(tileY, tileY + 1u);
+            uint32_t sourceY = y1 / multiplier;
+            if (source && sourceY > reach)
+                source->Release(0u, (sourceY - reach) / source->GetTileSize());
+        }
+    }
+
+    void TiledAutomata::ReadWindow(const TiledGrid& cells, int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+    {
+        int64_t width = cells.GetWidth();
+        int64_t height = cells.GetHeight();
+        window.Resize(static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0));
+        //The window is read in rectangles which do not cross the edges of the grid:
+        for (int64_t y = y0; y < y1;)
+        {
+            int64_t cellsY = floorModulo(y, height);
+            int64_t rows = std::min(y1 - y, height - cellsY);
+            for (int64_t x = x0; x < x1;)
+            {
+                int64_t cellsX = floorModulo(x, width);
+                int64_t columns = std::min(x1 - x, width - cellsX);
+                cells.Read(
+                    static_cast<uint32_t>(cellsX), static_cast<uint32_t>(cellsY),
+                    static_cast<uint32_t>(columns), static_cast<uint32_t>(rows),
+                    window, static_cast<uint32_t>(x - x0), static_cast<uint32_t>(y - y0));
+                x += columns;
+            }
+            y += rows;
+        }
+    }
+
+    void TiledAutomata::InitializeRandom(
+        TiledGrid& cells,
+        const CellRandom& random, uint32_t percent, uint32_t chosenType, uint32_t otherType)
+    {
+        ForEachTile(nullptr, cells, 1u, 0u, [&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+            {
+                ca.Resize(x1 - x0, y1 - y0);
+                ca.SetOrigin(x0, y0);
+                ca.InitializeRandom(random, percent, chosenType, otherType);
+                cells.Write(x0, y0, ca.GetCells());
+            });
+    }
+
+    bool TiledAutomata::RefineTiles(
+        const TiledGrid& cells, TiledGrid& refined,
+        uint32_t multiplier, uint32_t radius,
+        const std::function<void()>& refine)
+    {
+        if (!refined.Resize(cells.GetWidth() * multiplier, cells.GetHeight() * multiplier))
+            return false;
+        ForEachTile(&cells, refined, multiplier, radius + 1u, [&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+            {
+                uint32_t parentX0 = x0 / multiplier > radius ? x0 / multiplier - radius : 0u;
+                uint32_t parentY0 = y0 / multiplier > radius ? y0 / multiplier - radius : 0u;
+                uint32_t parentX1 = std::min((x1 + multiplier - 1u) / multiplier + radius, cells.GetWidth());
+                uint32_t parentY1 = std::min((y1 + multiplier - 1u) / multiplier + radius, cells.GetHeight());
+                ReadWindow(cells, parentX0, parentY0, parentX1, parentY1);
+                ca.SetCells(window.GetView());
+                ca.SetOrigin(parentX0, parentY0);
+                refine();
+
+                CellularAutomata::GridView scaled = ca.GetCells();
+                uint32_t offsetX = x0 - parentX0 * multiplier;
+                uint32_t offsetY = y0 - parentY0 * multiplier;
+                refined.Write(x0, y0, CellularAutomata::GridView(
+                    scaled.Row(offsetY) + offsetX, x1 - x0, y1 - y0, scaled.GetStride(), 0u));
+            });
+        return true;
+    }
+
+    bool TiledAutomata::Scale(const TiledGrid& cells, TiledGrid& scaled, uint32_t multiplier)
+    {
+        return RefineTiles(cells, scaled, multiplier, 0u, [this, multiplier]()
+            {
+                ca.Scale(multiplier);
+            });
+    }
+
+    bool TiledAutomata::RefineRandom(
+        const TiledGrid& cells, TiledGrid& refined,
+        uint32_t multiplier,
+        const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType)
+    {
+        return RefineTiles(cells, refined, multiplier, 0u, [&]()
+            {
+                ca.RefineRandom(multiplier, random, percent, firstType, secondType);
+            });
+    }
+
+    bool TiledAutomata::RefineBorders(
+        const TiledGrid& cells, TiledGrid& refined,
+        uint32_t multiplier,
+        const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType,
+        uint32_t radius)
+    {
+        //Whether a parent is near a border depends on the parents within the radius, which are part of the window:
+        return RefineTiles(cells, refined, multiplier, radius, [&]()
+            {
+                ca.RefineBorders(multiplier, random, percent, firstType, secondType, radius);
+            });
+    }
+
+    bool TiledAutomata::Generate(const TiledGrid& cells, TiledGrid& next, uint32_t n, uint32_t m)
+    {
+        if (!next.Resize(cells.GetWidth(), cells.GetHeight()))
+            return false;
+        int64_t reach = static_cast<int64_t>(n) * m;
+        bool wrap = ca.GetBoundary().policy == BoundaryPolicy::Wrap;
+        ForEachTile(&cells, next, 1u, static_cast<uint32_t>(reach), [&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+            {
+                //The cells within the reach of the edges of the window differ from the grid, and are not written:
+                int64_t windowX0 = x0 - reach;
+                int64_t windowY0 = y0 - reach;
+                int64_t windowX1 = x1 + reach;
+                int64_t windowY1 = y1 + reach;
+                if (!wrap)
+                {
+                    windowX0 = std::max<int64_t>(windowX0, 0);
+                    windowY0 = std::max<int64_t>(windowY0, 0);
+                    windowX1 = std::min<int64_t>(windowX1, cells.GetWidth());
+                    windowY1 = std::min<int64_t>(windowY1, cells.GetHeight());
+                }
+                ReadWindow(cells, windowX0, windowY0, windowX1, windowY1);
+                ca.SetCells(window.GetView());
+                ca.SetOrigin(windowX0, windowY0);
+                ca.Generate(n);
+
+                CellularAutomata::GridView stepped = ca.GetCells();
+                uint32_t offsetX = static_cast<uint32_t>(x0 - windowX0);
+                uint32_t offsetY = static_cast<uint32_t>(y0 - windowY0);
+                next.Write(x0, y0, CellularAutomata::GridView(
+                    stepped.Row(offsetY) + offsetX, x1 - x0, y1 - y0, stepped.GetStride(), 0u));
+            });
+        return true;
+    }
+
+    std::vector<TiledAutomata::GroupAnalysis> TiledAutomata::AnalyzeGroups(const TiledGrid& cells) const
+    {
+        uint32_t width = cells.GetWidth();
+        uint32_t height = cells.GetHeight();
+        uint32_t tileSize = cells.GetTileSize();
+
+        //Every part of a group found before it is known to be joined to other parts gets a label.
+        //The parts are joined with a union-find, where every part points towards the part of its group with the lowest label.
+        std::vector<uint32_t> parents;
+        std::vector<GroupAnalysis> parts;
+        //Index of the first cell of every part in the order of the rows of the grid, which orders the groups.
+        std::vector<uint64_t> firstCells;
+        auto find = [&parents](uint32_t label)
+        {
+            while (parents[label] != label)
+            {
+                parents[label] = parents[parents[label]];
+                label = parents[label];
+            }
+            return label;
+        };
+        auto join = [&parents, &find](uint32_t first, uint32_t second)
+        {
+            first = find(first);
+            second = find(second);
+            if (first != second)
+                parents[std::max(first, second)] = std::min(first, second);
+        };
+
+        //The labels of the last row of the tiles above, and of the last column of the tile to the left:
+        std::vector<uint32_t> aboveLabels(width);
+        std::vector<uint32_t> leftLabels(tileSize);
+        std::vector<uint32_t> nextLeftLabels(tileSize);
+        std::vector<uint32_t> rowLabels(tileSize);
+        std::vector<uint32_t> previousRowLabels(tileSize);
+        CellularAutomata::Grid tile;
+        for (uint32_t tileY = 0u; tileY < cells.GetTileCountY(); tileY++)
+        {
+            uint32_t y0 = tileY * tileSize;
+            uint32_t y1 = std::min(y0 + tileSize, height);
+            for (uint32_t tileX = 0u; tileX < cells.GetTileCountX(); tileX++)
+            {
+                uint32_t x0 = tileX * tileSize;
+                uint32_t x1 = std::min(x0 + tileSize, width);
+                //The tile is read with the row above it and the column to the left of it, so the cells are compared with them:
+                uint32_t offsetX = x0 > 0u ? 1u : 0u;
+                uint32_t offsetY = y0 > 0u ? 1u : 0u;
+                tile.Resize(x1 - x0 + offsetX, y1 - y0 + offsetY);
+                cells.Read(x0 - offsetX, y0 - offsetY, x1 - x0 + offsetX, y1 - y0 + offsetY, tile);
+
+                for (uint32_t y = y0; y < y1; y++)
+                {
+                    //Indexed by the column within the tile. The cells before the first column are the column to the left:
+                    const CellularAutomata::CellType* row = tile.Row(y - y0 + offsetY) + offsetX;
+                    const CellularAutomata::CellType* above = y > 0u ? tile.Row(y - y0 + offsetY - 1u) + offsetX : nullptr;
+                    for (uint32_t x = x0; x < x1; x++)
+                    {
+                        uint32_t type = row[x - x0];
+                        bool sameAsLeft = x > 0u && row[static_cast<int64_t>(x - x0) - 1] == type;
+                        bool sameAsAbove = y > 0u && above[x - x0] == type;
+                        uint32_t leftLabel = 0u;
+                        if (sameAsLeft)
+                            leftLabel = x > x0 ? rowLabels[x - x0 - 1u] : leftLabels[y - y0];
+                        uint32_t aboveLabel = 0u;
+                        if (sameAsAbove)
+                            aboveLabel = y > y0 ? previousRowLabels[x - x0] : aboveLabels[x];
+
+                        uint32_t label;
+                        if (sameAsLeft)
+                        {
+                            label = leftLabel;
+                            if (sameAsAbove)
+                                join(label, aboveLabel);
+                        }
+                        else if (sameAsAbove)
+                            label = aboveLabel;
+                        else
+                        {
+                            label = static_cast<uint32_t>(parents.size());
+                            parents.push_back(label);
+                            parts.push_back({ .cellType = type });
+                            firstCells.push_back(static_cast<uint64_t>(y) * width + x);
+                        }
+                        rowLabels[x - x0] = label;
+
+                        GroupAnalysis& part = parts[label];
+                        part.count++;
+                        part.minX = std::min(part.minX, x);
+                        part.maxX = std::max(part.maxX, x);
+                        part.minY = std::min(part.minY, y);
+                        part.maxY = std::max(part.maxY, y);
+                    }
+                    nextLeftLabels[y - y0] = rowLabels[x1 - x0 - 1u];
+                    std::swap(rowLabels, previousRowLabels);
+                }
+                std::copy_n(previousRowLabels.begin(), x1 - x0, aboveLabels.begin() + x0);
+                std::swap(leftLabels, nextLeftLabels);
+            }
+            cells.Release(tileY, tileY + 1u);
+        }
+
+        //Every part is added to the part with the lowest label of its group, which has the first cell of the group:
+        std::vector<GroupAnalysis> analyses;
+        std::vector<uint64_t> groupFirstCells;
+        std::vector<uint32_t> groups(parts.size());
+        for (uint32_t label = 0u; label < parts.size(); label++)
+        {
+            uint32_t root = find(label);
+            if (root == label)
+            {
+                groups[label] = static_cast<uint32_t>(analyses.size());
+                analyses.push_back(parts[label]);
+                groupFirstCells.push_back(firstCells[label]);
+                continue;
+            }
+            GroupAnalysis& group = analyses[groups[root]];
+            const GroupAnalysis& part = parts[label];
+            group.count += part.count;
+            group.minX = std::min(group.minX, part.minX);
+            group.maxX = std::max(group.maxX, part.maxX);
+            group.minY = std::min(group.minY, part.minY);
+            group.maxY = std::max(group.maxY, part.maxY);
+            groupFirstCells[groups[root]] = std::min(groupFirstCells[groups[root]], firstCells[label]);
+        }
+
+        //The parts are labelled a tile at a time, so the groups are sorted by their first cell in the order of the rows:
+        std::vector<uint32_t> order(analyses.size());
+        for (uint32_t i = 0u; i < order.size(); i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&groupFirstCells](uint32_t first, uint32_t second)
+            {
+                return groupFirstCells[first] < groupFirstCells[second];
+            });
+        std::vector<GroupAnalysis> sorted;
+        sorted.reserve(analyses.size());
+        for (uint32_t i : order)
+            sorted.push_back(analyses[i]);
+        return sorted;
+    }
+}
@@ -0,0 +1,96 @@
+/*
+* Initializes, steps, scales and analyses TiledGrid grids with a cellular automata, one tile at a time.
+* Every tile of the result is computed from a window of the cells it depends on, which is read into the automata,
+* so the rule, engine, threads and boundary of the automata are used as they are on a whole grid.
+* The window of a step is the tile with n * m cells on every side, and the window of a refinement is the parent cells
+* covering the tile, so the result is the same as on the whole grid, while only the window is kept in memory.
+* Windows at the edges of the grid are limited to it, so the boundary of the automata is the boundary of the grid there.
+* Under BoundaryPolicy::Wrap the windows of steps read the cells across the opposite edges instead.
+* The rows of tiles which are done with are released, so the memory taken does not grow with the grid.
+* Of the analyses only AnalyzeGroups is supported, as groups can be joined across the edges of tiles from a row of labels.
+* CellularAutomata::AnalyzeBorders follows every border around the whole grid and keeps an explored flag per cell and the
+* position of every border cell, and AnalyzePath keeps a search node per cell of the grid, so neither is streamed a tile
+* at a time. For this reason maps generated into a TiledGrid cannot be given to addDataPoint or the sweeps of Generator.h.
+*/
+
+#ifndef PCG_TILEDAUTOMATA_H
+#define PCG_TILEDAUTOMATA_H
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include "CellularAutomata.h"
+#include "TiledGrid.h"
+
+namespace pcg
+{
+    class TiledAutomata
+    {
+    public:
+        //Like CellularAutomata::GroupAnalysis, but without the positions of the cells, which take more memory than the grid.
+        struct GroupAnalysis
+        {
+            uint64_t count = 0u;
+            uint32_t cellType = 0u;
+            uint32_t minX = std::numeric_limits<uint32_t>::max();
+            uint32_t maxX = 0u;
+            uint32_t minY = std::numeric_limits<uint32_t>::max();
+            uint32_t maxY = 0u;
+        };
+    private:
+        CellularAutomata& ca;
+        CellularAutomata::Grid window;
+
+        //Calls visit with every tile of the destination, from x0 up to x1 and from y0 up to y1, a row of tiles at a time.
+        //The rows of tiles of the destination are released once they are done, and the rows of the source
+        //before the cells the next row of tiles depends on, which start reach cells before its first row divided by the multiplier.
+        void ForEachTile(
+            const TiledGrid* source, TiledGrid& destination,
+            uint32_t multiplier, uint32_t reach,
+            const std::function<void(uint32_t, uint32_t, uint32_t, uint32_t)>& visit);
+        //Reads the cells from (x0, y0) up to (x1, y1) into the window. Cells outside the grid are read across the opposite edge.
+        void ReadWindow(const TiledGrid& cells, int64_t x0, int64_t y0, int64_t x1, int64_t y1);
+        //Refines every tile from the parent cells covering it and radius parent cells around them, limited to the grid.
+        //refine is called with the parent cells in the automata and their origin set, and must leave the refined cells in it.
+        [[nodiscard]]
+        bool RefineTiles(
+            const TiledGrid& cells, TiledGrid& refined,
+            uint32_t multiplier, uint32_t radius,
+            const std::function<void()>& refine);
+    public:
+        //The grid and origin of the automata are replaced by every call, but its other settings are kept.
+        explicit TiledAutomata(CellularAutomata& ca);
+        //Like CellularAutomata::InitializeRandom on the whole grid, which keeps its size.
+        void InitializeRandom(
+            TiledGrid& cells,
+            const CellRandom& random, uint32_t percent, uint32_t chosenType, uint32_t otherType);
+        //Writes the cells scaled by the multiplier into scaled, which is resized. Returns false if it cannot be resized.
+        [[nodiscard]]
+        bool Scale(const TiledGrid& cells, TiledGrid& scaled, uint32_t multiplier);
+        //Like CellularAutomata::RefineRandom, writing the refined cells into refined, which is resized.
+        [[nodiscard]]
+        bool RefineRandom(
+            const TiledGrid& cells, TiledGrid& refined,
+            uint32_t multiplier,
+            const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType);
+        //Like CellularAutomata::RefineBorders, writing the refined cells into refined, which is resized.
+        [[nodiscard]]
+        bool RefineBorders(
+            const TiledGrid& cells, TiledGrid& refined,
+            uint32_t multiplier,
+            const CellRandom& random, uint32_t percent, uint32_t firstType, uint32_t secondType,
+            uint32_t radius);
+        //Writes the cells after n steps of the rule of the automata into next, which is resized.
+        //The rule must only read cells within a Moore neighbourhood of radius m.
+        [[nodiscard]]
+        bool Generate(const TiledGrid& cells, TiledGrid& next, uint32_t n, uint32_t m);
+        //The same groups as CellularAutomata::AnalyzeGroups in the same order. The grid is read once, a tile at a time,
+        //and the groups crossing the edges of tiles are joined, so only a row of cells is kept besides the groups.
+        //There are no tiled border or path analyses, see the top of this file.
+        [[nodiscard]]
+        std::vector<GroupAnalysis> AnalyzeGroups(const TiledGrid& cells) const;
+    };
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include "TiledGrid.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace pcg
+{
+    TiledGrid::~TiledGrid()
+    {
+        Close();
+    }
+
+    bool TiledGrid::Create(const std::string& path, uint32_t width, uint32_t height, uint32_t tileSize)
+    {
+        Close();
+        this->path = path;
+        this->tileSize = std::max(tileSize, 1u);
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(
+            path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+        file = handle;
+#else
+        file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (file < 0)
+            return false;
+#endif
+        return Resize(width, height);
+    }
+
+    bool TiledGrid::Resize(uint32_t width, uint32_t height)
+    {
+        if (!IsOpen())
+            return false;
+        Unmap();
+        this->width = width;
+        this->height = height;
+        tileCountX = (width + tileSize - 1u) / tileSize;
+        tileCountY = (height + tileSize - 1u) / tileSize;
+        return Map();
+    }
+
+    bool TiledGrid::Map()
+    {
+        //Tiles at the right and bottom edges take the room of whole tiles, so every tile is found the same way:
+        mappedBytes = static_cast<size_t>(tileCountX) * tileCountY * tileSize * tileSize;
+        if (mappedBytes == 0u)
+            return true;
+#ifdef _WIN32
+        //The mapping grows the file to its size:
+        uint64_t bytes = mappedBytes;
+        mapping = CreateFileMappingA(
+            file, nullptr, PAGE_READWRITE,
+            static_cast<DWORD>(bytes >> 32), static_cast<DWORD>(bytes & 0xffffffffull), nullptr);
+        if (mapping == nullptr)
+            return false;
+        void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, mappedBytes);
+        if (view == nullptr)
+        {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            return false;
+        }
+#else
+        if (ftruncate(file, static_cast<off_t>(mappedBytes)) != 0)
+            return false;
+        void* view = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (view == MAP_FAILED)
+            return false;
+#endif
+        cells = static_cast<CellType*>(view);
+        return true;
+    }
+
+    void TiledGrid::Unmap()
+    {
+        if (cells == nullptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(cells);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(cells, mappedBytes);
+#endif
+        cells = nullptr;
+    }
+
+    void TiledGrid::Close()
+    {
+        if (!IsOpen())
+            return;
+        Unmap();
+#ifdef _WIN32
+        CloseHandle(file);
+        file = nullptr;
+#else
+        close(file);
+        file = -1;
+#endif
+        width = 0u;
+        height = 0u;
+        tileCountX = 0u;
+        tileCountY = 0u;
+    }
+
+    bool TiledGrid::IsOpen() const
+    {
+#ifdef _WIN32
+        return file != nullptr;
+#else
+        return file >= 0;
+#endif
+    }
+
+    void TiledGrid::Read(
+        uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+        BasicGrid<CellType>& cells, uint32_t cellsX, uint32_t cellsY) const
+    {
+        for (uint32_t row = 0u; row < height; row++)
+        {
+            CellType* destination = cells.Row(cellsY + row) + cellsX;
+            //The row is copied a tile at a time, as the cells of a row are only contiguous within a tile:
+            for (uint32_t x0 = x; x0 < x + width;)
+            {
+                uint32_t x1 = std::min((x0 / tileSize + 1u) * tileSize, x + width);
+                std::memcpy(destination + (x0 - x), this->cells + Index(x0, y + row), x1 - x0);
+                x0 = x1;
+            }
+        }
+    }
+
+    void TiledGrid::Write(uint32_t x, uint32_t y, BasicGridView<CellType> cells)
+    {
+        uint32_t width = cells.GetWidth();
+        for (uint32_t row = 0u; row < cells.GetHeight(); row++)
+        {
+            const CellType* source = cells.Row(row);
+            for (uint32_t x0 = x; x0 < x + width;)
+            {
+                uint32_t x1 = std::min((x0 / tileSize + 1u) * tileSize, x + width);
+                std::memcpy(this->cells + Index(x0, y + row), source + (x0 - x), x1 - x0);
+                x0 = x1;
+            }
+        }
+    }
+
+    void TiledGrid::Release(uint32_t tileRowBegin, uint32_t tileRowEnd) const
+    {
+        tileRowEnd = std::min(tileRowEnd, tileCountY);
+        if (cells == nullptr || tileRowBegin >= tileRowEnd)
+            return;
+        size_t tileRowBytes = static_cast<size_t>(tileCountX) * tileSize * tileSize;
+        size_t begin = tileRowBegin * tileRowBytes;
+        size_t end = tileRowEnd * tileRowBytes;
+#ifdef _WIN32
+        FlushViewOfFile(cells + begin, end - begin);
+        //Unlocking pages which are not locked removes them from the working set of the process:
+        VirtualUnlock(cells + begin, end - begin);
+#else
+        //The range must start at a page. The part of the page before the rows is read again if it is used:
+        size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        begin -= begin % pageSize;
+        msync(cells + begin, end - begin, MS_ASYNC);
+        //The mapping is shared, so the changed pages are kept by the file and only the mapping of them is dropped:
+        madvise(cells + begin, end - begin, MADV_DONTNEED);
+#endif
+    }
+
+    void TiledGrid::Flush()
+    {
+        if (cells == nullptr)
+            return;
+#ifdef _WIN32
+        FlushViewOfFile(cells, 0);
+        FlushFileBuffers(file);
+#else
+        msync(cells, mappedBytes, MS_SYNC);
+#endif
+    }
+
+    uint32_t TiledGrid::GetWidth() const
+    {
+        return width;
+    }
+
+    uint32_t TiledGrid::GetHeight() const
+    {
+        return height;
+    }
+
+    uint32_t TiledGrid::GetTileSize() const
+    {
+        return tileSize;
+    }
+
+    uint32_t TiledGrid::GetTileCountX() const
+    {
+        return tileCountX;
+    }
+
+    uint32_t TiledGrid::GetTileCountY() const
+    {
+        return tileCountY;
+    }
+
+    const std::string& TiledGrid::GetPath() const
+    {
+        return path;
+    }
+}
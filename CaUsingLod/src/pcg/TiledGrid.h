@@ -0,0 +1,109 @@
+/*
+* A grid of cells too large to be kept in memory, stored in a file which is mapped into memory.
+* The cells are stored in square tiles, and the cells of every tile are contiguous in the file,
+* so a tile and its neighbours take few pages. The operating system reads pages from the file when they are used,
+* and writes them back and drops them when memory is needed, so only the tiles in use take memory.
+* Release drops the rows of tiles which are done with right away.
+* The file is mapped with MapViewOfFile on Windows and mmap elsewhere.
+* TiledAutomata steps, scales and analyses such grids one window of cells at a time.
+*/
+
+#ifndef PCG_TILEDGRID_H
+#define PCG_TILEDGRID_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "Grid.h"
+
+namespace pcg
+{
+    class TiledGrid
+    {
+    public:
+        using CellType = uint8_t;
+    private:
+        std::string path;
+        CellType* cells = nullptr;
+        size_t mappedBytes = 0u;
+        uint32_t width = 0u;
+        uint32_t height = 0u;
+        uint32_t tileSize = 0u;
+        uint32_t tileCountX = 0u;
+        uint32_t tileCountY = 0u;
+#ifdef _WIN32
+        void* file = nullptr;
+        void* mapping = nullptr;
+#else
+        int file = -1;
+#endif
+
+        //Maps the file with room for every tile of the grid, growing the file if needed.
+        [[nodiscard]]
+        bool Map();
+        void Unmap();
+        [[nodiscard]]
+        size_t Index(uint32_t x, uint32_t y) const;
+    public:
+        TiledGrid() = default;
+        TiledGrid(const TiledGrid& other) = delete;
+        TiledGrid& operator=(const TiledGrid& other) = delete;
+        ~TiledGrid();
+        //Creates the file, or replaces it, for a grid of the given size. The cells are undefined until they are written.
+        //Returns false if the file cannot be created or mapped.
+        [[nodiscard]]
+        bool Create(const std::string& path, uint32_t width, uint32_t height, uint32_t tileSize);
+        //Changes the size of the grid, keeping the file and the tile size. The cells are undefined until they are written.
+        [[nodiscard]]
+        bool Resize(uint32_t width, uint32_t height);
+        //Closes the file, which keeps the cells.
+        void Close();
+        [[nodiscard]]
+        bool IsOpen() const;
+        void Set(uint32_t type, uint32_t x, uint32_t y);
+        [[nodiscard]]
+        uint32_t Get(uint32_t x, uint32_t y) const;
+        //Copies the rectangle, which must be within the grid, into cells with its first cell at (cellsX, cellsY).
+        //The rectangle must fit within the live cells of cells.
+        void Read(
+            uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+            BasicGrid<CellType>& cells, uint32_t cellsX = 0u, uint32_t cellsY = 0u) const;
+        //Writes the live cells of the view into the grid with its first cell at (x, y). The cells must fit within the grid.
+        void Write(uint32_t x, uint32_t y, BasicGridView<CellType> cells);
+        //Starts writing the changed cells of the rows of tiles [tileRowBegin, tileRowEnd) back to the file,
+        //and drops them from memory. The cells are kept, and they are read from the file again if they are used later.
+        void Release(uint32_t tileRowBegin, uint32_t tileRowEnd) const;
+        //Writes every changed cell back to the file.
+        void Flush();
+        [[nodiscard]]
+        uint32_t GetWidth() const;
+        [[nodiscard]]
+        uint32_t GetHeight() const;
+        [[nodiscard]]
+        uint32_t GetTileSize() const;
+        [[nodiscard]]
+        uint32_t GetTileCountX() const;
+        [[nodiscard]]
+        uint32_t GetTileCountY() const;
+        [[nodiscard]]
+        const std::string& GetPath() const;
+    };
+
+    inline size_t TiledGrid::Index(uint32_t x, uint32_t y) const
+    {
+        size_t tile = static_cast<size_t>(y / tileSize) * tileCountX + x / tileSize;
+        return tile * tileSize * tileSize + static_cast<size_t>(y % tileSize) * tileSize + x % tileSize;
+    }
+
+    inline void TiledGrid::Set(uint32_t type, uint32_t x, uint32_t y)
+    {
+        cells[Index(x, y)] = static_cast<CellType>(type);
+    }
+
+    inline uint32_t TiledGrid::Get(uint32_t x, uint32_t y) const
+    {
+        return cells[Index(x, y)];
+    }
+}
+
+#endif